@@ -16,13 +16,17 @@
 
 #include "Arena.hpp"
 #include <algorithm>
+#include <atomic>
 #include <cstdlib>
+#include <mutex>
+#include <vector>
 
 namespace hexl {
 
 #define OFFSETOF_FIELD(structName, field) ((size_t)&(((structName*)0)->field))
 
 const size_t Arena::chunkSize = 32 * 1024;
+const size_t Arena::maxChunkSize = 1024 * 1024;
 
 struct Chunk {
   size_t size;
@@ -32,38 +36,35 @@ struct Chunk {
 
 const size_t Arena::chunkReserved = OFFSETOF_FIELD(Chunk, data);
 
-Arena::Arena()
-  : chunk(0),
-    allocPos(0)
+namespace {
+
+std::atomic<size_t> chunkBytes(0);
+std::atomic<size_t> chunkBytesMax(0);
+std::atomic<size_t> usedMax(0);
+std::atomic<uint64_t> poolReuses(0);
+
+void UpdateMax(std::atomic<size_t>& max, size_t value)
 {
+  size_t m = max.load(std::memory_order_relaxed);
+  while (value > m && !max.compare_exchange_weak(m, value, std::memory_order_relaxed)) { }
 }
 
-Arena::~Arena()
-{
-  Release();
 }
 
-size_t Arena::Used() const
+Arena::Arena()
+  : first(0),
+    chunk(0),
+    allocPos(0),
+    used(0),
+    size(0),
+    highWater(0),
+    nextChunkSize(chunkSize)
 {
-  size_t size = 0;
-  Chunk* chunk = this->chunk;
-  if (chunk) { size += allocPos; chunk = chunk->next; }
-  while (chunk) {
-    size += chunk->size;
-    chunk = chunk->next;
-  }
-  return size;
 }
 
-size_t Arena::Size() const
+Arena::~Arena()
 {
-  size_t size = 0;
-  Chunk* chunk = this->chunk;
-  while (chunk) {
-    size += chunk->size;
-    chunk = chunk->next;
-  }
-  return size;
+  Release();
 }
 
 void* Arena::Malloc(size_t size)
@@ -71,26 +72,52 @@ void* Arena::Malloc(size_t size)
   EnsureSpace(size);
   void *ptr = chunk->data + allocPos;
   allocPos += size;
+  used += size;
   return ptr;
 }
 
 void Arena::Release()
 {
-  while (chunk) {
-    Chunk* next = chunk->next;
-    free(chunk);
-    chunk = next;
+  Reset();
+  while (first) {
+    Chunk* next = first->next;
+    free(first);
+    first = next;
   }
+  chunkBytes -= size;
+  chunk = 0;
+  size = 0;
+  nextChunkSize = chunkSize;
+}
+
+void Arena::Reset()
+{
+  highWater = HighWater();
+  UpdateMax(usedMax, highWater);
+  used = 0;
+  chunk = first;
+  allocPos = 0;
 }
 
 void Arena::Grow(size_t size)
 {
-  size = std::max(size, chunkSize);
-  Chunk* next = chunk;
-  chunk = (Chunk*) malloc(size);
-  chunk->next = next;
-  chunk->size = size;
+  // Continue in the next chunk kept by Reset() if the allocation fits.
+  Chunk* next = chunk ? chunk->next : first;
+  if (next && chunkReserved + size <= next->size) {
+    chunk = next;
+    allocPos = 0;
+    return;
+  }
+  size_t csize = std::max(chunkReserved + size, nextChunkSize);
+  nextChunkSize = std::min(2 * nextChunkSize, maxChunkSize);
+  Chunk* c = (Chunk*) malloc(csize);
+  c->size = csize;
+  c->next = next;
+  if (chunk) { chunk->next = c; } else { first = c; }
+  chunk = c;
   allocPos = 0;
+  this->size += csize;
+  UpdateMax(chunkBytesMax, chunkBytes += csize);
 }
 
 void Arena::EnsureSpace(size_t size)
@@ -100,4 +127,98 @@ void Arena::EnsureSpace(size_t size)
   }
 }
 
+void Arena::Counters(CounterMap& counters)
+{
+  AddCounter(counters, "arena used bytes max", COUNTER_MAX, usedMax);
+  AddCounter(counters, "arena chunk bytes max", COUNTER_MAX, chunkBytesMax);
+  AddCounter(counters, "arena pool reuses", COUNTER_SUM, poolReuses);
+}
+
+namespace {
+
+const size_t THREAD_POOL_SIZE = 8;
+const size_t SHARED_POOL_SIZE = 64;
+// Larger arenas are freed when released, so that a single large test
+// does not keep its memory for the rest of the run.
+const size_t POOLED_ARENA_SIZE = 4 * 1024 * 1024;
+
+typedef std::vector<Arena*> ArenaList;
+
+std::mutex& SharedPoolMutex()
+{
+  static std::mutex* mutex = new std::mutex();
+  return *mutex;
+}
+
+ArenaList& SharedPool()
+{
+  static ArenaList* pool = new ArenaList();
+  return *pool;
+}
+
+// Moves arenas to the shared pool while it has room, deletes the rest.
+void ReleaseToShared(ArenaList& arenas)
+{
+  std::lock_guard<std::mutex> lock(SharedPoolMutex());
+  for (Arena* ap : arenas) {
+    if (SharedPool().size() < SHARED_POOL_SIZE) {
+      SharedPool().push_back(ap);
+    } else {
+      delete ap;
+    }
+  }
+  arenas.clear();
+}
+
+thread_local bool threadPoolDestroyed = false;
+
+struct ThreadPool {
+  ArenaList arenas;
+
+  ~ThreadPool()
+  {
+    threadPoolDestroyed = true;
+    ReleaseToShared(arenas);
+  }
+};
+
+thread_local ThreadPool threadPool;
+
+}
+
+Arena* ArenaPool::Acquire()
+{
+  if (!threadPoolDestroyed && !threadPool.arenas.empty()) {
+    Arena* ap = threadPool.arenas.back();
+    threadPool.arenas.pop_back();
+    ++poolReuses;
+    return ap;
+  }
+  {
+    std::lock_guard<std::mutex> lock(SharedPoolMutex());
+    if (!SharedPool().empty()) {
+      Arena* ap = SharedPool().back();
+      SharedPool().pop_back();
+      ++poolReuses;
+      return ap;
+    }
+  }
+  return new Arena();
+}
+
+void ArenaPool::Release(Arena* ap)
+{
+  if (ap->Size() > POOLED_ARENA_SIZE) {
+    ap->Release();
+  } else {
+    ap->Reset();
+  }
+  if (!threadPoolDestroyed && threadPool.arenas.size() < THREAD_POOL_SIZE) {
+    threadPool.arenas.push_back(ap);
+    return;
+  }
+  ArenaList arenas(1, ap);
+  ReleaseToShared(arenas);
+}
+
 }
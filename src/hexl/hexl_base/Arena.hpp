@@ -17,8 +17,13 @@
 #ifndef HC_ARENA_HPP
 #define HC_ARENA_HPP
 
+#include <algorithm>
 #include <cstddef>
+#include <map>
 #include <memory>
+#include <string>
+#include <stdint.h>
+#include "HexlCounters.hpp"
 
 namespace hexl {
 
@@ -28,22 +33,67 @@ class Arena {
 public:
   Arena();
   ~Arena();
-  size_t Used() const;
-  size_t Size() const;
+  /// Bytes allocated since construction or the last Reset().
+  size_t Used() const { return used; }
+  /// Bytes held in chunks.
+  size_t Size() const { return size; }
+  /// Largest Used() since construction.
+  size_t HighWater() const { return std::max(highWater, used); }
   void* Malloc(size_t size);
+  /// Frees all chunks.
   void Release();
+  /// Makes all chunks available for allocation again without freeing them.
+  void Reset();
+
+  /// Adds arena statistics of this process to counters: the largest
+  /// HighWater() of an arena and the peak of bytes held in chunks of
+  /// all arenas.
+  static void Counters(CounterMap& counters);
 
 private:
   Arena(const Arena&);
   Arena& operator=(const Arena&);
-  static const size_t chunkSize, chunkReserved;
+  static const size_t chunkSize, maxChunkSize, chunkReserved;
+  // Chunks in allocation order, chunks after the current one are kept by Reset().
+  Chunk* first;
   Chunk* chunk;
   size_t allocPos;
+  size_t used;
+  size_t size;
+  size_t highWater;
+  size_t nextChunkSize;
 
   void Grow(size_t size);
   void EnsureSpace(size_t size);
 };
 
+/// Arenas kept for reuse. Released arenas are reset and handed out again
+/// by Acquire() on the same thread, so that their chunks are reused by
+/// the next test. Arenas released by a thread with a full pool, or after
+/// its pool is gone on thread exit, are shared with other threads. The
+/// shared pool is never destroyed, so arenas may be released during
+/// static destruction.
+class ArenaPool {
+public:
+  static Arena* Acquire();
+  static void Release(Arena* ap);
+};
+
+/// Arena taken from ArenaPool for the lifetime of this object.
+class PooledArena {
+private:
+  Arena* ap;
+
+  PooledArena(const PooledArena&);
+  PooledArena& operator=(const PooledArena&);
+
+public:
+  PooledArena() : ap(ArenaPool::Acquire()) { }
+  ~PooledArena() { ArenaPool::Release(ap); }
+
+  Arena* Get() { return ap; }
+};
+
 template <typename Tp>
 struct ArenaAllocator : public std::allocator<Tp> {
   Arena* ap;
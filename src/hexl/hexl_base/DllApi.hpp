@@ -21,6 +21,7 @@
 #include <Windows.h>
 #else
 #include "dlfcn.h"
+#include <link.h>
 #endif
 #include "HexlTest.hpp"
 
@@ -101,6 +102,22 @@ public:
 
   const ApiTable* operator->() const { return apiTable; }
 
+  /// Path of the loaded library, or the name it was loaded by if the
+  /// path cannot be determined.
+  std::string LibraryPath() const {
+#ifdef _WIN32
+    char path[MAX_PATH];
+    DWORD length = dllHandle ? GetModuleFileNameA(dllHandle, path, MAX_PATH) : 0;
+    if (length > 0 && length < MAX_PATH) { return std::string(path, length); }
+#else
+    struct link_map* map = 0;
+    if (dllHandle && dlinfo(dllHandle, RTLD_DI_LINKMAP, &map) == 0 && map && map->l_name && *map->l_name) {
+      return map->l_name;
+    }
+#endif
+    return libName;
+  }
+
   virtual const ApiTable* InitApiTable() = 0;
 
   bool Init() {
@@ -14,6 +14,19 @@
 
 namespace hexl {
 
+  std::atomic<uint64_t> Context::logGeneration(1);
+
+  void Context::ResolveLogStreams(uint64_t generation)
+  {
+    std::lock_guard<std::mutex> lock(logStreamsMutex);
+    if (logStreamsGeneration.load(std::memory_order_relaxed) == generation) { return; }
+    for (unsigned i = 0; i < LOG_LEVEL_COUNT; ++i) {
+      ContextPointer<std::ostream>* p = FindObject<ContextPointer<std::ostream>>(LogStreamKey((LogLevel) i));
+      logStreams[i].store(p ? p->Get() : 0, std::memory_order_release);
+    }
+    logStreamsGeneration.store(generation, std::memory_order_release);
+  }
+
   void Context::Print(std::ostream& out) const
   {
     for (auto i = map.begin(); i != map.end(); ++i) {
@@ -146,6 +159,19 @@ namespace hexl {
 
   static const unsigned MAX_SHOWN_FAILURES = 16;
 
+  static double ErrorValue(const Value& error)
+  {
+    switch (error.Type()) {
+    case MV_UINT8: return error.U8();
+    case MV_UINT16: return error.U16();
+    case MV_UINT32: return error.U32();
+    case MV_UINT64: return (double) error.U64();
+    case MV_FLOAT: return error.F();
+    case MV_DOUBLE: return error.D();
+    default: return 0; // Packed and 128-bit errors are only printed.
+    }
+  }
+
   bool ValidateMemory(Context* context, ValueType vtype, const Values& expected, const void *actualPtr, const std::string& method)
   {
     assert(expected.size() > 0);
@@ -179,6 +205,10 @@ namespace hexl {
     } else {
       context->Info() << "Successful " << comparison->GetChecks() << " comparisons." << std::endl;
     }
+    ValidationStats* validation = context->Validation();
+    if (validation) {
+      validation->Add(comparison->GetFailed(), comparison->GetChecks(), ErrorValue(comparison->GetMaxError()));
+    }
     return !comparison->IsFailed();
   }
 
@@ -1,11 +1,16 @@
 #ifndef HEXL_CONTEXT_HPP
 #define HEXL_CONTEXT_HPP
 
+#include <atomic>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <ostream>
+#include <vector>
 #include "MObject.hpp"
 #include "HexlObjects.hpp"
+#include "HexlLog.hpp"
 
 namespace hexl {
 
@@ -53,6 +58,18 @@ namespace hexl {
     ~ContextManagedPointer() { delete this->t;  }
   };
 
+  /// Pointer to object shared with other owners. The deleter of the
+  /// shared pointer (e.g. handing the object back to a pool) runs when
+  /// the last of them drops it.
+  template <typename T>
+  class ContextSharedPointer : public ContextPointer<T> {
+  private:
+    std::shared_ptr<T> p;
+
+  public:
+    ContextSharedPointer(const std::shared_ptr<T>& p_) : ContextPointer<T>(p_.get()), p(p_) { }
+  };
+
   template <typename T>
   class ContextValue : public ContextObject {
   private:
@@ -71,36 +88,52 @@ namespace hexl {
   private:
     Context* parent;
     std::map<std::string, std::unique_ptr<ContextObject>> map;
+    // Log streams resolved through parents. The cache is valid while its
+    // generation equals logGeneration, which is advanced whenever a log
+    // stream of any context or a parent link changes.
+    std::atomic<std::ostream*> logStreams[LOG_LEVEL_COUNT];
+    std::atomic<uint64_t> logStreamsGeneration;
+    std::mutex logStreamsMutex;
+    static std::atomic<uint64_t> logGeneration;
+
+    static bool IsLogStreamKey(const std::string& key) { return key.compare(0, 16, "hexl.log.stream.") == 0; }
+    static void InvalidateLogStreams() { logGeneration.fetch_add(1, std::memory_order_acq_rel); }
+    void ResolveLogStreams(uint64_t generation);
 
     void PutObject(const std::string& key, ContextObject* o)
     {
       map[key] = std::unique_ptr<ContextObject>(o);
+      if (IsLogStreamKey(key)) { InvalidateLogStreams(); }
     }
 
     template <typename T>
     T* GetObject(const std::string& key) const
+    {
+      T* o = FindObject<T>(key);
+      if (!o) {
+        std::cout << "Key: " << key << std::endl;
+        assert(!"Value not found");
+      }
+      return o;
+    }
+
+    template <typename T>
+    T* FindObject(const std::string& key) const
     {
       auto f = map.find(key);
       if (f != map.end()) {
         return static_cast<T*>(f->second.get());
       }
       else {
-        if (parent) {
-          return parent->GetObject<T>(key);
-        }
-        else {
-          std::cout << "Key: " << key << std::endl;
-          assert(!"Value not found");
-          return 0;
-        }
+        return parent ? parent->FindObject<T>(key) : 0;
       }
     }
 
   public:
     explicit Context(Context* parent_ = 0)
-      : parent(parent_) { }
+      : parent(parent_), logStreamsGeneration(0) { }
 
-    void SetParent(Context* parent) { this->parent = parent; }
+    void SetParent(Context* parent) { this->parent = parent; InvalidateLogStreams(); }
 
     void Print(std::ostream& out) const;
 
@@ -108,8 +141,10 @@ namespace hexl {
 
     bool Has(const std::string& key) const { return map.find(key) != map.end(); }
     bool Has(const std::string& path, const std::string& key) const { return Has(path + "." + key); }
+    /// Appends keys of this context, not of its parents, in sorted order.
+    void Keys(std::vector<std::string>& keys) const { for (auto& o : map) { keys.push_back(o.first); } }
 
-    void Clear() { map.clear(); }
+    void Clear() { map.clear(); InvalidateLogStreams(); }
 
     void Put(const std::string& key, const Value& value) { PutObject(key, new ContextValue<Value>(value)); }
     void Put(const std::string& path, const std::string& key, const Value& value) { Put(path + "." + key, value); }
@@ -132,6 +167,8 @@ namespace hexl {
     void Put(const std::string& key, T* t) { PutObject(key, new ContextUnmanagedPointer<T>(t)); }
     template <typename T>
     void Move(const std::string& key, T* t) { PutObject(key, new ContextManagedPointer<T>(t)); }
+    template <typename T>
+    void Share(const std::string& key, const std::shared_ptr<T>& t) { PutObject(key, new ContextSharedPointer<T>(t)); }
     template<class T>
     T* Get(const std::string& key) { return GetObject<ContextPointer<T>>(key)->Get(); }
     template<class T>
@@ -139,12 +176,22 @@ namespace hexl {
 
     Value GetRuntimeValue(Value v);
 
-    void Delete(const std::string& key) { map.erase(key); }
+    void Delete(const std::string& key) { map.erase(key); if (IsLogStreamKey(key)) { InvalidateLogStreams(); } }
 
     // Logging helpers.
-    std::ostream& Debug() { return *Get<std::ostream>("hexl.log.stream.debug"); }
-    std::ostream& Info() { return *Get<std::ostream>("hexl.log.stream.info"); }
-    std::ostream& Error() { return *Get<std::ostream>("hexl.log.stream.error"); }
+    /// Stream for log level, 0 if it is not set.
+    std::ostream* LogStream(LogLevel level)
+    {
+      uint64_t generation = logGeneration.load(std::memory_order_acquire);
+      if (logStreamsGeneration.load(std::memory_order_acquire) != generation) { ResolveLogStreams(generation); }
+      return logStreams[level].load(std::memory_order_acquire);
+    }
+    std::ostream& Log(LogLevel level) { std::ostream* out = LogStream(level); return out ? *out : *Get<std::ostream>(LogStreamKey(level)); }
+    std::ostream& Debug() { return Log(LOG_DEBUG); }
+    std::ostream& Info() { return Log(LOG_INFO); }
+    std::ostream& Error() { return Log(LOG_ERROR); }
+    /// Background log writer, 0 if logging is synchronous.
+    AsyncLogWriter* LogWriter() { ContextPointer<AsyncLogWriter>* p = FindObject<ContextPointer<AsyncLogWriter>>("hexl.log.writer"); return p ? p->Get() : 0; }
 
 #ifdef _WIN32
     void Win32Error(const std::string& msg = "");
@@ -176,6 +223,12 @@ namespace hexl {
     runtime::RuntimeContext* Runtime() { return Get<runtime::RuntimeContext>("hexl.runtime"); }
     const Options* Opts() const { return Get<Options>("hexl.options"); }
     AllStats& Stats() { return *Get<AllStats>("hexl.stats"); }
+    /// Phase times of current test, 0 if they are not collected.
+    PhaseTimes* Phases() { ContextPointer<PhaseTimes>* p = FindObject<ContextPointer<PhaseTimes>>("hexl.phases"); return p ? p->Get() : 0; }
+    /// Memory validation results of current test, 0 if they are not collected.
+    ValidationStats* Validation() { ContextPointer<ValidationStats>* p = FindObject<ContextPointer<ValidationStats>>("hexl.validation"); return p ? p->Get() : 0; }
+    /// Latencies of repeated dispatches of current test, 0 if they are not collected.
+    LatencyStats* Latency() { ContextPointer<LatencyStats>* p = FindObject<ContextPointer<LatencyStats>>("hexl.latency"); return p ? p->Get() : 0; }
   };
 
   bool ValidateMemory(Context* context, ValueType vtype, const Values& expected, const void *actualPtr, const std::string& method);
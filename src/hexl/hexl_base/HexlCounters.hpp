@@ -0,0 +1,54 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef HEXL_COUNTERS_HPP
+#define HEXL_COUNTERS_HPP
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <stdint.h>
+
+namespace hexl {
+
+/// How values of a counter from several sources (e.g. test workers)
+/// are combined.
+enum CounterKind {
+  COUNTER_SUM = 0,
+  COUNTER_MAX,
+};
+
+struct Counter {
+  CounterKind kind;
+  uint64_t value;
+
+  Counter() : kind(COUNTER_SUM), value(0) { }
+};
+
+/// Runtime event counters for the run summary, by name.
+typedef std::map<std::string, Counter> CounterMap;
+
+/// Combines value with counter name of given kind.
+inline void AddCounter(CounterMap& counters, const std::string& name, CounterKind kind, uint64_t value)
+{
+  Counter& c = counters[name];
+  c.kind = kind;
+  c.value = kind == COUNTER_MAX ? std::max(c.value, value) : c.value + value;
+}
+
+}
+
+#endif // HEXL_COUNTERS_HPP
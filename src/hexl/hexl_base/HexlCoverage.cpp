@@ -0,0 +1,406 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "HexlCoverage.hpp"
+#include "HexlHash.hpp"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <unordered_set>
+#include <cassert>
+#include <stdint.h>
+
+namespace hexl {
+
+namespace {
+
+typedef std::vector<int> Row;
+
+// Value of axis is not chosen yet.
+const int ANY = -1;
+
+// Combination of strength - 1 axes before the current axis and the
+// current one, with value tuples of these axes already covered by rows.
+struct Interaction {
+  std::vector<unsigned> axes;
+  std::vector<bool> covered;
+};
+
+class Ipog {
+private:
+  const std::vector<unsigned>& counts;
+  unsigned strength;
+  std::vector<Row> rows;
+  std::vector<Interaction> interactions;
+  unsigned axis;
+
+  // Index of values of row on interaction axes with value v of current
+  // axis, or -1 if some of them are not chosen.
+  int64_t TupleIndex(const Interaction& in, const Row& row, int v) const
+  {
+    int64_t index = 0;
+    for (unsigned a : in.axes) {
+      if (row[a] == ANY) { return -1; }
+      index = index * counts[a] + row[a];
+    }
+    return index * counts[axis] + v;
+  }
+
+  void AddInteractions(unsigned first, std::vector<unsigned>& axes)
+  {
+    if (axes.size() == strength - 1) {
+      Interaction in;
+      in.axes = axes;
+      size_t size = counts[axis];
+      for (unsigned a : axes) { size *= counts[a]; }
+      in.covered.assign(size, false);
+      interactions.push_back(in);
+      return;
+    }
+    for (unsigned a = first; a < axis; ++a) {
+      axes.push_back(a);
+      AddInteractions(a + 1, axes);
+      axes.pop_back();
+    }
+  }
+
+  void Cover(const Row& row)
+  {
+    if (row[axis] == ANY) { return; }
+    for (Interaction& in : interactions) {
+      int64_t index = TupleIndex(in, row, row[axis]);
+      if (index >= 0) { in.covered[index] = true; }
+    }
+  }
+
+  void GrowHorizontally()
+  {
+    for (Row& row : rows) {
+      int best = 0;
+      unsigned bestGain = 0;
+      for (int v = 0; v < (int) counts[axis]; ++v) {
+        unsigned gain = 0;
+        for (const Interaction& in : interactions) {
+          int64_t index = TupleIndex(in, row, v);
+          if (index >= 0 && !in.covered[index]) { ++gain; }
+        }
+        if (gain > bestGain) { best = v; bestGain = gain; }
+      }
+      row[axis] = best;
+      Cover(row);
+    }
+  }
+
+  void GrowVertically()
+  {
+    std::vector<int> values;
+    for (size_t i = 0; i < interactions.size(); ++i) {
+      Interaction& in = interactions[i];
+      for (size_t index = 0; index < in.covered.size(); ++index) {
+        if (in.covered[index]) { continue; }
+        // Values of interaction axes followed by value of current axis.
+        values.assign(in.axes.size() + 1, 0);
+        size_t rest = index;
+        values[in.axes.size()] = (int) (rest % counts[axis]);
+        rest /= counts[axis];
+        for (size_t j = in.axes.size(); j-- > 0; ) {
+          values[j] = (int) (rest % counts[in.axes[j]]);
+          rest /= counts[in.axes[j]];
+        }
+        Row* target = 0;
+        for (Row& row : rows) {
+          bool compatible = row[axis] == ANY || row[axis] == values[in.axes.size()];
+          for (size_t j = 0; compatible && j < in.axes.size(); ++j) {
+            int v = row[in.axes[j]];
+            compatible = v == ANY || v == values[j];
+          }
+          if (compatible) { target = &row; break; }
+        }
+        if (!target) {
+          rows.push_back(Row(counts.size(), ANY));
+          target = &rows.back();
+        }
+        for (size_t j = 0; j < in.axes.size(); ++j) { (*target)[in.axes[j]] = values[j]; }
+        (*target)[axis] = values[in.axes.size()];
+        Cover(*target);
+      }
+    }
+  }
+
+public:
+  Ipog(const std::vector<unsigned>& counts_, unsigned strength_)
+    : counts(counts_), strength(strength_), axis(0) { }
+
+  void Build()
+  {
+    // All combinations of the first strength axes.
+    size_t initial = 1;
+    for (unsigned a = 0; a < strength; ++a) { initial *= counts[a]; }
+    for (size_t i = 0; i < initial; ++i) {
+      Row row(counts.size(), ANY);
+      size_t rest = i;
+      for (unsigned a = strength; a-- > 0; ) {
+        row[a] = (int) (rest % counts[a]);
+        rest /= counts[a];
+      }
+      rows.push_back(row);
+    }
+    for (axis = strength; axis < counts.size(); ++axis) {
+      interactions.clear();
+      std::vector<unsigned> axes;
+      AddInteractions(0, axes);
+      GrowHorizontally();
+      GrowVertically();
+    }
+  }
+
+  void Indexes(std::vector<uint64_t>& indexes) const
+  {
+    for (const Row& row : rows) {
+      uint64_t index = 0;
+      for (size_t a = 0; a < counts.size(); ++a) {
+        // Any value of axes which are still not chosen will do.
+        index = index * counts[a] + (row[a] == ANY ? 0 : row[a]);
+      }
+      indexes.push_back(index);
+    }
+    std::sort(indexes.begin(), indexes.end());
+    indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+  }
+};
+
+// Covering arrays built so far by numbers of axis values and strength.
+// Test sets with parameters of the same shape and repeated iterations of
+// a test set share them. Never destroyed, as threads may still iterate
+// tests while static objects are destroyed at exit.
+struct CoveringArrayCache {
+  std::mutex mutex;
+  std::map<std::pair<std::vector<uint64_t>, unsigned>, std::vector<uint64_t>> arrays;
+};
+
+CoveringArrayCache& Cache()
+{
+  static CoveringArrayCache* cache = new CoveringArrayCache();
+  return *cache;
+}
+
+}
+
+void CoveringArray(const std::vector<uint64_t>& counts, unsigned strength, std::vector<uint64_t>& indexes)
+{
+  assert(strength > 0);
+  indexes.clear();
+  uint64_t total = 1;
+  for (uint64_t c : counts) { total *= c; }
+  if (total == 0) { return; }
+  if (strength >= counts.size()) {
+    for (uint64_t i = 0; i < total; ++i) { indexes.push_back(i); }
+    return;
+  }
+  CoveringArrayCache& cache = Cache();
+  std::pair<std::vector<uint64_t>, unsigned> key(counts, strength);
+  {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto f = cache.arrays.find(key);
+    if (f != cache.arrays.end()) { indexes = f->second; return; }
+  }
+  // Axes are single sequences of a product, small enough for Ipog.
+  std::vector<unsigned> axes;
+  for (uint64_t c : counts) { assert(c <= (unsigned) -1); axes.push_back((unsigned) c); }
+  Ipog ipog(axes, strength);
+  ipog.Build();
+  ipog.Indexes(indexes);
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.arrays.emplace(key, indexes);
+}
+
+namespace {
+
+// SplitMix64: fixed arithmetic, unlike distributions of <random>, so that
+// draws are the same with every standard library.
+class SampleRandom {
+private:
+  uint64_t state;
+
+public:
+  explicit SampleRandom(uint64_t seed) : state(seed) { }
+
+  uint64_t Next()
+  {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  /// Uniform in [0, bound).
+  uint64_t Below(uint64_t bound)
+  {
+    assert(bound > 0);
+    uint64_t limit = UINT64_MAX - UINT64_MAX % bound;
+    uint64_t r;
+    do { r = Next(); } while (r >= limit);
+    return r % bound;
+  }
+};
+
+}
+
+uint64_t MixSeed(uint64_t seed, const std::string& name)
+{
+  // Hash of name, started from the seed.
+  return SampleRandom(Hash64(seed ^ Hash64::OFFSET_BASIS).Add(name).Get()).Next();
+}
+
+void SampleIndexes(uint64_t count, unsigned n, uint64_t seed, std::vector<uint64_t>& indexes)
+{
+  indexes.clear();
+  if (n >= count) {
+    for (uint64_t i = 0; i < count; ++i) { indexes.push_back(i); }
+    return;
+  }
+  // Floyd's algorithm: n draws for n distinct indexes.
+  SampleRandom random(seed);
+  std::unordered_set<uint64_t> drawn;
+  for (uint64_t j = count - n; j < count; ++j) {
+    uint64_t t = random.Below(j + 1);
+    uint64_t i = drawn.insert(t).second ? t : j;
+    if (i == j) { drawn.insert(j); }
+    indexes.push_back(i);
+  }
+  std::sort(indexes.begin(), indexes.end());
+}
+
+namespace {
+
+// Completions of a tuple tried before it is left uncovered: all of them if
+// there are not more, otherwise that many drawn at random.
+const uint64_t MAX_REPAIR_CANDIDATES = 256;
+
+// Values of axes of the product row with index, the first axis most
+// significant.
+void RowValues(const std::vector<uint64_t>& counts, uint64_t index, std::vector<uint64_t>& values)
+{
+  values.resize(counts.size());
+  for (size_t a = counts.size(); a-- > 0; ) {
+    values[a] = index % counts[a];
+    index /= counts[a];
+  }
+}
+
+uint64_t RowIndex(const std::vector<uint64_t>& counts, const std::vector<uint64_t>& values)
+{
+  uint64_t index = 0;
+  for (size_t a = 0; a < counts.size(); ++a) { index = index * counts[a] + values[a]; }
+  return index;
+}
+
+// Tuples of values covered by rows, for every combination of strength axes.
+class TupleCover {
+private:
+  const std::vector<uint64_t>& counts;
+  std::vector<std::vector<unsigned>> combinations;
+  std::vector<std::unordered_set<uint64_t>> covered;
+
+  void AddCombinations(unsigned first, unsigned strength, std::vector<unsigned>& axes)
+  {
+    if (axes.size() == strength) { combinations.push_back(axes); return; }
+    for (unsigned a = first; a < counts.size(); ++a) {
+      axes.push_back(a);
+      AddCombinations(a + 1, strength, axes);
+      axes.pop_back();
+    }
+  }
+
+  uint64_t Tuple(size_t c, const std::vector<uint64_t>& values) const
+  {
+    uint64_t tuple = 0;
+    for (unsigned a : combinations[c]) { tuple = tuple * counts[a] + values[a]; }
+    return tuple;
+  }
+
+public:
+  TupleCover(const std::vector<uint64_t>& counts_, unsigned strength)
+    : counts(counts_)
+  {
+    std::vector<unsigned> axes;
+    AddCombinations(0, strength, axes);
+    covered.resize(combinations.size());
+  }
+
+  size_t Combinations() const { return combinations.size(); }
+  const std::vector<unsigned>& Axes(size_t c) const { return combinations[c]; }
+  bool IsCovered(size_t c, const std::vector<uint64_t>& values) const { return covered[c].count(Tuple(c, values)) > 0; }
+  void Cover(size_t c, const std::vector<uint64_t>& values) { covered[c].insert(Tuple(c, values)); }
+  void Cover(const std::vector<uint64_t>& values) { for (size_t c = 0; c < combinations.size(); ++c) { Cover(c, values); } }
+};
+
+}
+
+void ValidCoveringArray(const std::vector<uint64_t>& counts, unsigned strength, const std::function<bool(uint64_t)>& isValid, std::vector<uint64_t>& indexes)
+{
+  std::vector<uint64_t> rows;
+  CoveringArray(counts, strength, rows);
+  indexes.clear();
+  std::vector<uint64_t> invalid;
+  for (uint64_t row : rows) { (isValid(row) ? indexes : invalid).push_back(row); }
+  // All combinations are already there if strength covers all axes.
+  if (invalid.empty() || strength >= counts.size()) { return; }
+  TupleCover cover(counts, strength);
+  std::vector<uint64_t> values, candidate;
+  for (uint64_t row : indexes) {
+    RowValues(counts, row, values);
+    cover.Cover(values);
+  }
+  std::unordered_set<uint64_t> tried(invalid.begin(), invalid.end());
+  for (uint64_t row : invalid) {
+    RowValues(counts, row, values);
+    for (size_t c = 0; c < cover.Combinations(); ++c) {
+      if (cover.IsCovered(c, values)) { continue; }
+      // Complete the tuple of combination c with values of other axes.
+      const std::vector<unsigned>& axes = cover.Axes(c);
+      std::vector<unsigned> others;
+      uint64_t completions = 1;
+      for (unsigned a = 0; a < counts.size(); ++a) {
+        if (std::find(axes.begin(), axes.end(), a) == axes.end()) {
+          others.push_back(a);
+          completions *= counts[a];
+        }
+      }
+      SampleRandom random(row * cover.Combinations() + c);
+      bool all = completions <= MAX_REPAIR_CANDIDATES;
+      bool found = false;
+      for (uint64_t i = 0; i < (all ? completions : MAX_REPAIR_CANDIDATES) && !found; ++i) {
+        uint64_t rest = all ? i : random.Below(completions);
+        candidate = values;
+        for (size_t j = others.size(); j-- > 0; ) {
+          candidate[others[j]] = rest % counts[others[j]];
+          rest /= counts[others[j]];
+        }
+        uint64_t index = RowIndex(counts, candidate);
+        if (!tried.insert(index).second || !isValid(index)) { continue; }
+        indexes.push_back(index);
+        cover.Cover(candidate);
+        found = true;
+      }
+      // Tuples without valid completions are not searched for again.
+      if (!found) { cover.Cover(c, values); }
+    }
+  }
+  std::sort(indexes.begin(), indexes.end());
+}
+
+}
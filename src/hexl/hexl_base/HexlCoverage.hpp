@@ -0,0 +1,54 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef HEXL_COVERAGE_HPP
+#define HEXL_COVERAGE_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace hexl {
+
+/// Covering array of strength t over axes with given numbers of values:
+/// rows of a cartesian product of the axes such that every combination
+/// of values of any t axes appears in at least one row.
+///
+/// Rows are returned as sorted indexes into the product enumerated with
+/// the first axis most significant, as SequenceProduct does. Built with
+/// the deterministic IPOG greedy algorithm, so all processes enumerating
+/// a test set get the same rows.
+void CoveringArray(const std::vector<uint64_t>& counts, unsigned strength, std::vector<uint64_t>& indexes);
+
+/// Covering array of strength t restricted to rows for which isValid is
+/// true. Rows of CoveringArray which are not valid are replaced by valid
+/// rows covering the same t-tuples, where such rows are found among a
+/// bounded number of candidates, so that constraints on test parameters
+/// do not drop tuples from coverage.
+void ValidCoveringArray(const std::vector<uint64_t>& counts, unsigned strength, const std::function<bool(uint64_t)>& isValid, std::vector<uint64_t>& indexes);
+
+/// Seed for random draws made under name, derived from seed, so that
+/// different names draw independently of each other.
+uint64_t MixSeed(uint64_t seed, const std::string& name);
+
+/// n distinct indexes out of count drawn uniformly at random, sorted.
+/// Depends only on seed and is the same on all platforms.
+void SampleIndexes(uint64_t count, unsigned n, uint64_t seed, std::vector<uint64_t>& indexes);
+
+}
+
+#endif // HEXL_COVERAGE_HPP
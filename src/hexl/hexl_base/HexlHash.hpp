@@ -0,0 +1,58 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef HEXL_HASH_HPP
+#define HEXL_HASH_HPP
+
+#include <cstddef>
+#include <string>
+#include <stdint.h>
+
+namespace hexl {
+
+/// 64-bit FNV-1a hash. It depends only on the hashed bytes, so hashes are
+/// the same across runs and platforms and can be stored in files.
+/// Data hashed in several parts gives the hash of their concatenation.
+class Hash64 {
+private:
+  uint64_t hash;
+
+public:
+  static const uint64_t OFFSET_BASIS = 14695981039346656037ULL;
+  static const uint64_t PRIME = 1099511628211ULL;
+
+  explicit Hash64(uint64_t hash_ = OFFSET_BASIS) : hash(hash_) { }
+
+  Hash64& Add(const void* data, size_t size)
+  {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+      hash ^= bytes[i];
+      hash *= PRIME;
+    }
+    return *this;
+  }
+  Hash64& Add(const std::string& s) { return Add(s.data(), s.size()); }
+  Hash64& Add(char c) { return Add(&c, 1); }
+
+  uint64_t Get() const { return hash; }
+
+  static uint64_t Of(const std::string& s) { return Hash64().Add(s).Get(); }
+};
+
+}
+
+#endif // HEXL_HASH_HPP
@@ -0,0 +1,207 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "HexlLog.hpp"
+#include <chrono>
+#include <vector>
+#include <cassert>
+
+namespace hexl {
+
+const char* LogStreamKey(LogLevel level)
+{
+  switch (level) {
+  case LOG_DEBUG: return "hexl.log.stream.debug";
+  case LOG_INFO: return "hexl.log.stream.info";
+  case LOG_ERROR: return "hexl.log.stream.error";
+  default: assert(false); return "";
+  }
+}
+
+int LogBuffer::Buf::overflow(int ch)
+{
+  if (ch != traits_type::eof()) { text.push_back((char) ch); }
+  return ch;
+}
+
+std::streamsize LogBuffer::Buf::xsputn(const char* s, std::streamsize n)
+{
+  text.append(s, (size_t) n);
+  return n;
+}
+
+std::string LogBuffer::Take()
+{
+  std::string result;
+  result.swap(buf.text);
+  return result;
+}
+
+// Threads passing text to the writer less often than once per line.
+static const size_t THREAD_BUFFER_SIZE = 4096;
+
+namespace {
+
+struct ThreadLogBuffer {
+  AsyncLogWriter* writer;
+  std::ostream* out;
+  std::string text;
+
+  ThreadLogBuffer() : writer(0), out(0) { }
+  ~ThreadLogBuffer() { Submit(); }
+
+  void Submit()
+  {
+    if (writer && !text.empty()) {
+      writer->Write(out, std::move(text));
+      text.clear();
+    }
+  }
+
+  std::string& Use(AsyncLogWriter* writer, std::ostream* out)
+  {
+    // Keep order of text written by this thread to different streams.
+    if (writer != this->writer || out != this->out) {
+      Submit();
+      this->writer = writer;
+      this->out = out;
+    }
+    return text;
+  }
+};
+
+thread_local ThreadLogBuffer threadBuffer;
+
+}
+
+AsyncLogWriter::AsyncLogWriter()
+  : head(0), idle(false), queued(0), written(0), stop(false)
+{
+  thread = std::thread(&AsyncLogWriter::Run, this);
+}
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+  if (threadBuffer.writer == this) { threadBuffer.Submit(); }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  wake.notify_one();
+  thread.join();
+}
+
+void AsyncLogWriter::Write(std::ostream* out, std::string&& text)
+{
+  Chunk* c = new Chunk();
+  c->out = out;
+  c->text = std::move(text);
+  c->next = head.load(std::memory_order_relaxed);
+  while (!head.compare_exchange_weak(c->next, c, std::memory_order_release, std::memory_order_relaxed)) { }
+  queued.fetch_add(1, std::memory_order_release);
+  // Writer also wakes up periodically, so a notification missed here only delays output.
+  if (idle.load(std::memory_order_relaxed)) { wake.notify_one(); }
+}
+
+void AsyncLogWriter::Flush()
+{
+  if (threadBuffer.writer == this) { threadBuffer.Submit(); }
+  uint64_t target = queued.load(std::memory_order_acquire);
+  std::unique_lock<std::mutex> lock(mutex);
+  wake.notify_one();
+  done.wait(lock, [this, target] { return written >= target; });
+}
+
+void AsyncLogWriter::Run()
+{
+  std::vector<std::ostream*> outs;
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    Chunk* list = head.exchange(0, std::memory_order_acquire);
+    if (!list) {
+      if (stop) { return; }
+      idle = true;
+      wake.wait_for(lock, std::chrono::milliseconds(50));
+      idle = false;
+      continue;
+    }
+    lock.unlock();
+    // Chunks are pushed in front of the list, restore queue order.
+    Chunk* ordered = 0;
+    while (list) {
+      Chunk* next = list->next;
+      list->next = ordered;
+      ordered = list;
+      list = next;
+    }
+    uint64_t count = 0;
+    outs.clear();
+    while (ordered) {
+      Chunk* c = ordered;
+      ordered = c->next;
+      c->out->write(c->text.data(), c->text.size());
+      if (outs.empty() || outs.back() != c->out) { outs.push_back(c->out); }
+      delete c;
+      ++count;
+    }
+    for (std::ostream* out : outs) { out->flush(); }
+    lock.lock();
+    written += count;
+    done.notify_all();
+  }
+}
+
+int AsyncLogStream::Buf::overflow(int ch)
+{
+  if (ch != traits_type::eof()) {
+    char c = (char) ch;
+    stream->Append(&c, 1);
+  }
+  return ch;
+}
+
+std::streamsize AsyncLogStream::Buf::xsputn(const char* s, std::streamsize n)
+{
+  stream->Append(s, (size_t) n);
+  return n;
+}
+
+int AsyncLogStream::Buf::sync()
+{
+  stream->Submit();
+  return 0;
+}
+
+void AsyncLogStream::Append(const char* s, size_t n)
+{
+  std::string& text = threadBuffer.Use(writer, out);
+  text.append(s, n);
+  if (text.size() >= THREAD_BUFFER_SIZE) { threadBuffer.Submit(); }
+}
+
+void AsyncLogStream::Write(std::string&& text)
+{
+  threadBuffer.Use(writer, out);
+  threadBuffer.Submit();
+  if (!text.empty()) { writer->Write(out, std::move(text)); }
+}
+
+void AsyncLogStream::Submit()
+{
+  if (threadBuffer.writer == writer && threadBuffer.out == out) { threadBuffer.Submit(); }
+}
+
+}
@@ -0,0 +1,138 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef HEXL_LOG_HPP
+#define HEXL_LOG_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <stdint.h>
+
+namespace hexl {
+
+enum LogLevel {
+  LOG_DEBUG = 0,
+  LOG_INFO,
+  LOG_ERROR,
+  LOG_LEVEL_COUNT
+};
+
+/// Context key of the output stream for log level.
+const char* LogStreamKey(LogLevel level);
+
+/// Output stream collecting text in a string, which can be taken
+/// without copying.
+class LogBuffer : public std::ostream {
+private:
+  class Buf : public std::streambuf {
+  public:
+    std::string text;
+
+  protected:
+    virtual int overflow(int ch);
+    virtual std::streamsize xsputn(const char* s, std::streamsize n);
+  };
+
+  Buf buf;
+
+public:
+  LogBuffer() : std::ostream(&buf) { }
+
+  const std::string& Text() const { return buf.text; }
+  bool IsEmpty() const { return buf.text.empty(); }
+  /// Returns collected text and clears the buffer.
+  std::string Take();
+  void Clear() { buf.text.clear(); }
+};
+
+/// Background thread writing log text to output streams.
+///
+/// Chunks of text are queued by any thread without locking and written
+/// by the background thread in the order they were queued, so file and
+/// console output is done off the thread running the tests.
+class AsyncLogWriter {
+private:
+  struct Chunk {
+    std::ostream* out;
+    std::string text;
+    Chunk* next;
+  };
+
+  std::atomic<Chunk*> head;
+  std::atomic<bool> idle;
+  std::atomic<uint64_t> queued;
+  uint64_t written;
+  bool stop;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  std::thread thread;
+
+  void Run();
+
+public:
+  AsyncLogWriter();
+  ~AsyncLogWriter();
+
+  void Write(std::ostream* out, std::string&& text);
+  /// Waits until all text queued so far is written and flushed.
+  void Flush();
+};
+
+/// Output stream which collects text in a buffer of the calling thread
+/// and passes it to AsyncLogWriter on flush (e.g. std::endl) or when
+/// the buffer becomes large. Can be used from several threads at once.
+class AsyncLogStream : public std::ostream {
+private:
+  class Buf : public std::streambuf {
+  private:
+    AsyncLogStream* stream;
+
+  public:
+    explicit Buf(AsyncLogStream* stream_) : stream(stream_) { }
+
+  protected:
+    virtual int overflow(int ch);
+    virtual std::streamsize xsputn(const char* s, std::streamsize n);
+    virtual int sync();
+  };
+
+  AsyncLogWriter* writer;
+  std::ostream* out;
+  Buf buf;
+
+  void Append(const char* s, size_t n);
+
+public:
+  AsyncLogStream(AsyncLogWriter* writer_, std::ostream* out_)
+    : std::ostream(&buf), writer(writer_), out(out_), buf(this) { }
+  ~AsyncLogStream() { Submit(); }
+
+  AsyncLogWriter* Writer() { return writer; }
+  /// Queues text after the text buffered by calling thread, without copying it.
+  void Write(std::string&& text);
+  /// Queues text buffered by calling thread.
+  void Submit();
+};
+
+}
+
+#endif // HEXL_LOG_HPP
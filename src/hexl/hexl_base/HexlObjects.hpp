@@ -15,6 +15,10 @@ namespace hexl {
   namespace runtime { class RuntimeContext; class RuntimeState; }
   class Options;
   class AllStats;
+  class PhaseTimes;
+  class ValidationStats;
+  class LatencyStats;
+  class AsyncLogWriter;
   class GridGeometry;
   class Value;
   class ImageParams;
@@ -57,6 +61,18 @@ namespace hexl {
   template <>
   inline void Print<AllStats>(const AllStats& tf, std::ostream& out) { }
 
+  template <>
+  inline void Print<PhaseTimes>(const PhaseTimes& tf, std::ostream& out) { }
+
+  template <>
+  inline void Print<ValidationStats>(const ValidationStats& tf, std::ostream& out) { }
+
+  template <>
+  inline void Print<LatencyStats>(const LatencyStats& tf, std::ostream& out) { }
+
+  template <>
+  inline void Print<AsyncLogWriter>(const AsyncLogWriter& tf, std::ostream& out) { }
+
   template <>
   inline void Print<runtime::RuntimeContext>(const runtime::RuntimeContext& tf, std::ostream& out) { }
 
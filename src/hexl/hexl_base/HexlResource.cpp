@@ -22,13 +22,53 @@
 #ifdef _WIN32
 #include <windows.h>
 #else
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 namespace hexl {
 
+namespace {
+
+class StringResourceData : public ResourceData {
+private:
+  std::string text;
+
+public:
+  explicit StringResourceData(std::string&& text_) : text(std::move(text_)) { }
+  const char* Data() const { return text.data(); }
+  size_t Size() const { return text.size(); }
+};
+
+#ifndef _WIN32
+class MappedResourceData : public ResourceData {
+private:
+  void* data;
+  size_t size;
+
+public:
+  MappedResourceData(void* data_, size_t size_) : data(data_), size(size_) { }
+  ~MappedResourceData() { munmap(data, size); }
+  const char* Data() const { return static_cast<const char*>(data); }
+  size_t Size() const { return size; }
+};
+#endif // _WIN32
+
+}
+
+ResourceData* ResourceManager::GetData(const std::string& name)
+{
+  std::istream* in = Get(name);
+  if (!in) { return 0; }
+  std::string text((std::istreambuf_iterator<char>(*in)), std::istreambuf_iterator<char>());
+  delete in;
+  return new StringResourceData(std::move(text));
+}
+
 std::istream* DirectoryResourceManager::Get(const std::string& name)
 {
   std::ifstream* in = new std::ifstream(GetBasedName(name).c_str());
@@ -36,6 +76,28 @@ std::istream* DirectoryResourceManager::Get(const std::string& name)
   return in;
 }
 
+ResourceData* DirectoryResourceManager::GetData(const std::string& name)
+{
+#ifdef _WIN32
+  // Text mode stream translates line ends.
+  return ResourceManager::GetData(name);
+#else
+  int fd = open(GetBasedName(name).c_str(), O_RDONLY);
+  if (fd < 0) { return 0; }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    // Empty files cannot be mapped, pipes and devices can only be read.
+    close(fd);
+    return ResourceManager::GetData(name);
+  }
+  void* data = mmap(0, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) { return ResourceManager::GetData(name); }
+  madvise(data, (size_t) st.st_size, MADV_SEQUENTIAL);
+  return new MappedResourceData(data, (size_t) st.st_size);
+#endif // _WIN32
+}
+
 std::ostream* DirectoryResourceManager::GetOutput(const std::string& name)
 {
   std::ofstream* out = new std::ofstream(GetOutputFileName(name).c_str());
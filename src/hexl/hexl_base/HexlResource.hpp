@@ -23,11 +23,21 @@
 
 namespace hexl {
 
+/// Read-only contents of a whole resource, released on delete.
+class ResourceData {
+public:
+  virtual ~ResourceData() { }
+  virtual const char* Data() const = 0;
+  virtual size_t Size() const = 0;
+};
+
 class ResourceManager {
 public:
   virtual ~ResourceManager() { }
   virtual void Print(std::ostream& out) const = 0;
   virtual std::istream* Get(const std::string& name) = 0;
+  /// Contents of resource or 0 if it is not found. Reads Get() by default.
+  virtual ResourceData* GetData(const std::string& name);
   virtual std::string GetBasedName(const std::string& name) const = 0;
   virtual std::string GetOutputFileName(const std::string& name) const = 0;
   virtual std::string GetOutputDirName(const std::string& name) const = 0;
@@ -40,6 +50,8 @@ public:
     : testbase(testbase_), results(results_) { }
   void Print(std::ostream& out) const { out << "tests: " << testbase << " results: " << results; }
   virtual std::istream* Get(const std::string& name);
+  /// Memory-maps the file where supported.
+  virtual ResourceData* GetData(const std::string& name);
   virtual std::string GetBasedName(const std::string& name) const;
   virtual std::string GetOutputFileName(const std::string& name) const;
   virtual std::string GetOutputDirName(const std::string& name) const;
@@ -0,0 +1,238 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "HexlResultSink.hpp"
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace hexl {
+
+static const unsigned FLUSH_INTERVAL = 1; // Seconds.
+
+static void JsonString(std::ostream& out, const std::string& s)
+{
+  out << '"';
+  for (char c : s) {
+    switch (c) {
+    case '"': out << "\\\""; break;
+    case '\\': out << "\\\\"; break;
+    case '\n': out << "\\n"; break;
+    case '\t': out << "\\t"; break;
+    default:
+      if ((unsigned char) c < 0x20) {
+        out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (unsigned) c << std::dec << std::setfill(' ');
+      } else {
+        out << c;
+      }
+    }
+  }
+  out << '"';
+}
+
+// Quotes CSV field if it contains a separator, quote or line break.
+static void CsvString(std::ostream& out, const std::string& s)
+{
+  if (s.find_first_of(",\"\r\n") == std::string::npos) { out << s; return; }
+  out << '"';
+  for (char c : s) {
+    if (c == '"') { out << '"'; }
+    out << c;
+  }
+  out << '"';
+}
+
+static void XmlString(std::ostream& out, const std::string& s)
+{
+  for (char c : s) {
+    switch (c) {
+    case '"': out << "&quot;"; break;
+    case '&': out << "&amp;"; break;
+    case '<': out << "&lt;"; break;
+    case '>': out << "&gt;"; break;
+    default: out << c;
+    }
+  }
+}
+
+static void SplitTestName(const std::string& fullTestName, std::string& path, std::string& name)
+{
+  size_t pos = fullTestName.find_last_of('/');
+  if (pos == std::string::npos) {
+    path.clear();
+    name = fullTestName;
+  } else {
+    path = fullTestName.substr(0, pos);
+    name = fullTestName.substr(pos + 1);
+  }
+}
+
+// Writes fields of a JSON object for test name, status, time and phase
+// times, shared by -timings and -jsonresults records.
+static void WriteJsonTimes(std::ostream& out, const std::string& fullTestName, const TestResult& result)
+{
+  std::string path, testName;
+  SplitTestName(fullTestName, path, testName);
+  const PhaseTimes& phases = result.Phases();
+  out << "\"path\": "; JsonString(out, path);
+  out << ", \"test\": "; JsonString(out, testName);
+  out << ", \"hash\": \"" << TestHashString(TestNameHash(fullTestName)) << "\"";
+  out << ", \"status\": \"" << result.StatusString() << "\"";
+  out << ", \"time\": " << result.Time() / 1e9;
+  out << ", \"phases\": {";
+  for (unsigned i = 0; i < PHASE_COUNT; ++i) {
+    if (i > 0) { out << ", "; }
+    out << "\"" << TestPhaseString(i) << "\": " << phases.Seconds(i);
+  }
+  out << "}";
+}
+
+bool FileResultSink::Open()
+{
+  out.open(name.c_str(), std::ofstream::out);
+  if (!out.is_open()) {
+    context->Error() << "Failed to open " << name << std::endl;
+    return false;
+  }
+  out << std::fixed << std::setprecision(6);
+  Begin();
+  out.flush();
+  lastFlush = std::chrono::steady_clock::now();
+  return true;
+}
+
+void FileResultSink::Close()
+{
+  if (!out.is_open()) { return; }
+  End();
+  out.close();
+}
+
+void FileResultSink::Written()
+{
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (now - lastFlush >= std::chrono::seconds(FLUSH_INTERVAL)) {
+    out.flush();
+    lastFlush = now;
+  }
+}
+
+TimingsResultSink::TimingsResultSink(Context* context_, const std::string& name_)
+  : FileResultSink(context_, name_)
+{
+  json = name.size() >= 5 && name.compare(name.size() - 5, 5, ".json") == 0;
+}
+
+void TimingsResultSink::Begin()
+{
+  if (json) { return; }
+  out << "test,status,time";
+  for (unsigned i = 0; i < PHASE_COUNT; ++i) { out << "," << TestPhaseString(i); }
+  out << "\n";
+}
+
+void TimingsResultSink::TestCompleted(const std::string& fullTestName, const TestResult& result)
+{
+  const PhaseTimes& phases = result.Phases();
+  if (json) {
+    out << "{";
+    WriteJsonTimes(out, fullTestName, result);
+    out << "}\n";
+  } else {
+    CsvString(out, fullTestName);
+    out << "," << result.StatusString() << "," << result.Time() / 1e9;
+    for (unsigned i = 0; i < PHASE_COUNT; ++i) { out << "," << phases.Seconds(i); }
+    out << "\n";
+  }
+  Written();
+}
+
+void JsonResultSink::TestCompleted(const std::string& fullTestName, const TestResult& result)
+{
+  const ValidationStats& validation = result.Validation();
+  out << "{";
+  WriteJsonTimes(out, fullTestName, result);
+  out << ", \"failures\": " << validation.Failures();
+  out << ", \"checks\": " << validation.Checks();
+  out << ", \"max_error\": ";
+  if (std::isfinite(validation.MaxError())) {
+    std::ostringstream maxError;
+    maxError << std::setprecision(17) << validation.MaxError();
+    out << maxError.str();
+  } else {
+    out << "null";
+  }
+  const LatencyStats& latency = result.Latency();
+  if (!latency.IsEmpty()) {
+    out << ", \"latency\": {\"count\": " << latency.Count() <<
+      ", \"min\": " << latency.Min() / 1e9 << ", \"median\": " << latency.Median() / 1e9 <<
+      ", \"p90\": " << latency.P90() / 1e9 << ", \"p99\": " << latency.P99() / 1e9 << "}";
+  }
+  out << "}\n";
+  Written();
+}
+
+void JUnitResultSink::Begin()
+{
+  out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+  out << "<testsuites>\n";
+}
+
+void JUnitResultSink::End()
+{
+  if (!suite.empty()) { out << "  </testsuite>\n"; }
+  out << "</testsuites>\n";
+}
+
+void JUnitResultSink::TestCompleted(const std::string& fullTestName, const TestResult& result)
+{
+  std::string path, testName;
+  SplitTestName(fullTestName, path, testName);
+  std::string suiteName = path.empty() ? "/" : path;
+  if (suiteName != suite) {
+    // Tests are reported grouped by path, so a suite is complete once path changes.
+    if (!suite.empty()) { out << "  </testsuite>\n"; }
+    suite = suiteName;
+    out << "  <testsuite name=\""; XmlString(out, suite); out << "\">\n";
+  }
+  std::string className = path;
+  for (char& c : className) { if (c == '/') { c = '.'; } }
+  out << "    <testcase classname=\""; XmlString(out, className);
+  out << "\" name=\""; XmlString(out, testName);
+  out << "\" time=\"" << result.Time() / 1e9 << "\"";
+  const ValidationStats& validation = result.Validation();
+  switch (result.Status()) {
+  case PASSED:
+    out << "/>\n";
+    break;
+  case NA:
+    out << ">\n" << "      <skipped/>\n" << "    </testcase>\n";
+    break;
+  default:
+    out << ">\n";
+    out << "      <" << (result.Status() == FAILED ? "failure" : "error") << " message=\"" << result.StatusString();
+    if (validation.Failures() > 0) {
+      out << ": failed " << validation.Failures() << " / " << validation.Checks() <<
+        " comparisons";
+    }
+    out << "\"/>\n";
+    out << "    </testcase>\n";
+    break;
+  }
+  Written();
+}
+
+}
@@ -0,0 +1,101 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef HEXL_RESULT_SINK_HPP
+#define HEXL_RESULT_SINK_HPP
+
+#include "HexlTest.hpp"
+#include <chrono>
+#include <fstream>
+#include <string>
+
+namespace hexl {
+
+/// Receives results of tests as they complete, in reporting order.
+class ResultSink {
+public:
+  virtual ~ResultSink() { }
+  virtual bool Open() { return true; }
+  virtual void TestCompleted(const std::string& fullTestName, const TestResult& result) = 0;
+  virtual void Close() { }
+};
+
+/// Base for sinks writing a file. Nothing is kept in memory between
+/// tests; the file is flushed at least once per second so that it can
+/// be followed while tests run.
+class FileResultSink : public ResultSink {
+private:
+  std::chrono::steady_clock::time_point lastFlush;
+
+protected:
+  Context* context;
+  std::string name;
+  std::ofstream out;
+
+  virtual void Begin() { }
+  virtual void End() { }
+  void Written();
+
+public:
+  FileResultSink(Context* context_, const std::string& name_)
+    : context(context_), name(name_) { }
+
+  virtual bool Open();
+  virtual void Close();
+};
+
+/// Per test and per phase times in CSV format, or one JSON object per
+/// line, as JsonResultSink writes, if the file name ends with .json.
+/// Every record is complete once written, so the file stays valid if
+/// the run is interrupted.
+class TimingsResultSink : public FileResultSink {
+private:
+  bool json;
+
+protected:
+  virtual void Begin();
+
+public:
+  TimingsResultSink(Context* context_, const std::string& name_);
+  virtual void TestCompleted(const std::string& fullTestName, const TestResult& result);
+};
+
+/// One JSON object per line for every test.
+class JsonResultSink : public FileResultSink {
+public:
+  JsonResultSink(Context* context_, const std::string& name_)
+    : FileResultSink(context_, name_) { }
+  virtual void TestCompleted(const std::string& fullTestName, const TestResult& result);
+};
+
+/// JUnit XML report. Tests with the same path form a test suite.
+class JUnitResultSink : public FileResultSink {
+private:
+  std::string suite;
+
+protected:
+  virtual void Begin();
+  virtual void End();
+
+public:
+  JUnitResultSink(Context* context_, const std::string& name_)
+    : FileResultSink(context_, name_) { }
+  virtual void TestCompleted(const std::string& fullTestName, const TestResult& result);
+};
+
+}
+
+#endif // HEXL_RESULT_SINK_HPP
@@ -19,12 +19,17 @@
 #include "hsail_c.h"
 
 #include <string>
+#include <algorithm>
+#include <cstdlib>
 #include <cassert>
 #include <sstream>
 #include <cstdio>
+#include <cerrno>
 #include <fstream>
 
 #include "HexlResource.hpp"
+#include "HexlCoverage.hpp"
+#include "HexlHash.hpp"
 #include "Grid.hpp"
 
 namespace hexl {
@@ -50,25 +55,82 @@ void TestResult::IncStats(AllStats& allStats) const
   case NA: allStats.TestSet().IncNa(); break;
   default: assert(false); break;
   }
+  allStats.Phases().Append(phases);
 }
 
 void TestResult::Serialize(std::ostream& out) const
 {
   WriteData(out, status);
   WriteData(out, output);
+  WriteData(out, time);
+  for (unsigned i = 0; i < PHASE_COUNT; ++i) { WriteData(out, phases.Get(i)); }
+  WriteData(out, validation.Failures());
+  WriteData(out, validation.Checks());
+  WriteData(out, validation.MaxError());
+  WriteData(out, latency.Count());
+  WriteData(out, latency.Min());
+  WriteData(out, latency.Median());
+  WriteData(out, latency.P90());
+  WriteData(out, latency.P99());
 }
 
 void TestResult::Deserialize(std::istream& in)
 {
   ReadData(in, status);
   ReadData(in, output);
+  ReadData(in, time);
+  for (unsigned i = 0; i < PHASE_COUNT; ++i) {
+    uint64_t t;
+    ReadData(in, t);
+    phases.Set(i, t);
+  }
+  uint32_t failures, checks;
+  double maxError;
+  ReadData(in, failures);
+  ReadData(in, checks);
+  ReadData(in, maxError);
+  validation.Clear();
+  validation.Add(failures, checks, maxError);
+  uint32_t count;
+  uint64_t min, median, p90, p99;
+  ReadData(in, count);
+  ReadData(in, min);
+  ReadData(in, median);
+  ReadData(in, p90);
+  ReadData(in, p99);
+  latency.Set(count, min, median, p90, p99);
+}
+
+static std::atomic<uint64_t> nameLookups(0);
+static std::atomic<uint64_t> nameRenders(0);
+
+const std::string& Test::TestName() const
+{
+  nameLookups.fetch_add(1, std::memory_order_relaxed);
+  std::string* n = name.load(std::memory_order_acquire);
+  if (!n) {
+    nameRenders.fetch_add(1, std::memory_order_relaxed);
+    std::ostringstream ss;
+    Name(ss);
+    std::string* rendered = new std::string(ss.str());
+    // Thread losing the race drops its rendering and uses the stored one.
+    if (name.compare_exchange_strong(n, rendered, std::memory_order_acq_rel, std::memory_order_acquire)) {
+      n = rendered;
+    } else {
+      delete rendered;
+    }
+  }
+  return *n;
 }
 
-std::string Test::TestName() const
+uint64_t Test::NameLookups()
 {
-  std::ostringstream ss;
-  Name(ss);
-  return ss.str();
+  return nameLookups.load(std::memory_order_relaxed);
+}
+
+uint64_t Test::NameRenders()
+{
+  return nameRenders.load(std::memory_order_relaxed);
 }
 
 void TestImpl::Fail(const std::string& msg)
@@ -118,22 +180,41 @@ TestSpecList::~TestSpecList()
   }
 }
 
-class AddBaseTestSpecIterator : public TestSpecIterator {
+void TestNameList::operator()(const std::string& path, TestSpec* spec)
+{
+  spec->InitContext(context);
+  if (spec->IsValid()) {
+    ++count;
+    if (out) { *out << path << "/" << spec->TestName() << "\n"; }
+  }
+  delete spec;
+}
+
+class AddBaseTestSpecIterator : public ForwardingTestSpecIterator {
 public:
   AddBaseTestSpecIterator(const std::string& base_, TestSpecIterator& it_)
-    : base(base_), it(it_) { }
+    : ForwardingTestSpecIterator(it_), base(base_) { }
 
-  void operator()(const std::string& path, TestSpec* test)
+  void operator()(const std::string& path, TestSpec* test) override
   {
 //    it(base + "/" + path, test);
     it((base.empty() ? "" : base + "/") + path, test);
   }
+
+  uint64_t SampleSeed() override { return MixSeed(it.SampleSeed(), base); }
  
 private:
   const std::string& base;
-  TestSpecIterator& it;
 };
 
+TestNameFilter::TestNameFilter(const std::string& namePattern)
+  : pattern(new TestNamePattern())
+{
+  std::string error;
+  pattern->Compile(namePattern, error);
+  state = pattern->Start();
+}
+
 bool TestNameFilter::Matches(const std::string& path, Test* test)
 {
   std::string name = path + "/" + test->TestName();
@@ -142,24 +223,69 @@ bool TestNameFilter::Matches(const std::string& path, Test* test)
 
 bool TestNameFilter::Matches(const std::string& name)
 {
-  return (name.length() >= namePattern.length()) &&
-         (name.substr(0, namePattern.length()) == namePattern);
+  return pattern->Matches(state, name);
+}
+
+TestNameFilter* TestNameFilter::Descend(const std::string& base) const
+{
+  TestNamePattern::State s = pattern->Walk(state, base);
+  if (!base.empty()) { s = pattern->Enter(s); }
+  return new TestNameFilter(pattern, s);
+}
+
+unsigned ExcludeListFilter::Walk(unsigned node, const std::string& s) const
+{
+  const std::vector<Node>& nodes = *trie;
+  for (char c : s) {
+    if (node == NO_NODE || nodes[node].excluded) { break; }
+    unsigned next = NO_NODE;
+    for (const std::pair<char, unsigned>& e : nodes[node].next) {
+      if (e.first == c) { next = e.second; break; }
+    }
+    node = next;
+  }
+  return node;
 }
 
 bool ExcludeListFilter::Matches(const std::string& path, Test* test)
 {
-  std::string name = path + "/" + test->TestName();
-  return Matches(name);
+  unsigned node = Walk(Walk(root, path), "/");
+  return !IsExcluded(Walk(node, test->TestName()));
 }
 
 bool ExcludeListFilter::Matches(const std::string& name)
 {
-  for (std::string prefix : excludePrefixes) {
-    if (name.compare(0, prefix.length(), prefix) == 0) {
-      return false;
+  return !IsExcluded(Walk(root, name));
+}
+
+void ExcludeListFilter::AddPrefix(const std::string& prefix)
+{
+  assert(root == 0);
+  std::vector<Node>& nodes = *trie;
+  unsigned node = 0;
+  for (char c : prefix) {
+    if (nodes[node].excluded) { return; }
+    unsigned next = NO_NODE;
+    for (const std::pair<char, unsigned>& e : nodes[node].next) {
+      if (e.first == c) { next = e.second; break; }
+    }
+    if (next == NO_NODE) {
+      next = (unsigned) nodes.size();
+      nodes[node].next.push_back(std::make_pair(c, next));
+      nodes.push_back(Node());
     }
+    node = next;
   }
-  return true;
+  // Longer prefixes are covered by this one.
+  nodes[node].excluded = true;
+  nodes[node].next.clear();
+}
+
+ExcludeListFilter* ExcludeListFilter::Descend(const std::string& base) const
+{
+  unsigned node = Walk(root, base);
+  if (!base.empty()) { node = Walk(node, "/"); }
+  return new ExcludeListFilter(trie, node);
 }
 
 bool ExcludeListFilter::Load(ResourceManager* rm, const std::string& name)
@@ -188,12 +314,12 @@ TestSet* BasicTestSet::Filter(ExcludeListFilter* filter)
   return new FilteredTestSet(this, filter);
 }
 
-class FilterIterator : public TestSpecIterator {
+class FilterIterator : public ForwardingTestSpecIterator {
 public:
   FilterIterator(TestSpecIterator& it_, TestFilter* filter_)
-    : it(it_), filter(filter_) { }
+    : ForwardingTestSpecIterator(it_), filter(filter_) { }
 
-  void operator()(const std::string& path, TestSpec* test)
+  void operator()(const std::string& path, TestSpec* test) override
   {
     if (filter->Matches(path, test)) {
       it(path, test);
@@ -201,9 +327,11 @@ public:
       delete test;
     }
   }
+
+  // Filtered tests are not numbered like tests of the parent set.
+  uint64_t Skip(uint64_t count) override { return 0; }
  
 private:
-  TestSpecIterator& it;
   TestFilter* filter;
 };
 
@@ -224,6 +352,148 @@ void FilteredTestSet::Iterate(TestSpecIterator& it)
   parent->Iterate(fi);
 }
 
+class ShardIterator : public ForwardingTestSpecIterator {
+public:
+  ShardIterator(TestSpecIterator& it_, unsigned index_, unsigned count_)
+    : ForwardingTestSpecIterator(it_), index(index_), count(count_), position(0) { }
+
+  void operator()(const std::string& path, TestSpec* test) override
+  {
+    if (position % count == index) {
+      it(path, test);
+    } else {
+      delete test;
+    }
+    ++position;
+  }
+
+  uint64_t Skip(uint64_t n) override
+  {
+    uint64_t skip = std::min(n, (uint64_t) ((index + count - position % count) % count));
+    position += skip;
+    return skip;
+  }
+
+private:
+  unsigned index;
+  unsigned count;
+  uint64_t position;
+};
+
+TestSet* ShardTestSet::Filter(TestNameFilter* filter)
+{
+  return new FilteredTestSet(this, filter);
+}
+
+TestSet* ShardTestSet::Filter(ExcludeListFilter* filter)
+{
+  return new FilteredTestSet(this, filter);
+}
+
+void ShardTestSet::Iterate(TestSpecIterator& it)
+{
+  ShardIterator si(it, index, count);
+  parent->Iterate(si);
+}
+
+bool ShardTestSet::ParseShard(const std::string& s, unsigned& index, unsigned& count)
+{
+  char* end;
+  size_t pos = s.find('/');
+  if (pos == std::string::npos || pos == 0) { return false; }
+  index = (unsigned) strtoul(s.c_str(), &end, 10);
+  if (end != s.c_str() + pos) { return false; }
+  count = (unsigned) strtoul(s.c_str() + pos + 1, &end, 10);
+  if (*end || end == s.c_str() + pos + 1) { return false; }
+  return index < count;
+}
+
+class CoverageIterator : public ForwardingTestSpecIterator {
+public:
+  CoverageIterator(TestSpecIterator& it_, unsigned strength_, Context* context_)
+    : ForwardingTestSpecIterator(it_), strength(strength_), context(context_) { }
+
+  unsigned Coverage() override { return strength; }
+  Context* CoverageContext() override { return context; }
+
+private:
+  unsigned strength;
+  Context* context;
+};
+
+TestSet* CoverageTestSet::Filter(TestNameFilter* filter)
+{
+  return new FilteredTestSet(this, filter);
+}
+
+TestSet* CoverageTestSet::Filter(ExcludeListFilter* filter)
+{
+  return new FilteredTestSet(this, filter);
+}
+
+void CoverageTestSet::Iterate(TestSpecIterator& it)
+{
+  CoverageIterator ci(it, strength, context);
+  parent->Iterate(ci);
+}
+
+bool CoverageTestSet::ParseCoverage(const std::string& s, unsigned& strength)
+{
+  if (s == "t=2") { strength = 2; return true; }
+  if (s == "t=3") { strength = 3; return true; }
+  return false;
+}
+
+class SampleIterator : public ForwardingTestSpecIterator {
+public:
+  SampleIterator(TestSpecIterator& it_, unsigned count_, uint64_t seed_)
+    : ForwardingTestSpecIterator(it_), count(count_), seed(seed_) { }
+
+  unsigned Sample() override { return count; }
+  uint64_t SampleSeed() override { return seed; }
+
+private:
+  unsigned count;
+  uint64_t seed;
+};
+
+TestSet* SampleTestSet::Filter(TestNameFilter* filter)
+{
+  return new FilteredTestSet(this, filter);
+}
+
+TestSet* SampleTestSet::Filter(ExcludeListFilter* filter)
+{
+  return new FilteredTestSet(this, filter);
+}
+
+void SampleTestSet::Iterate(TestSpecIterator& it)
+{
+  SampleIterator si(it, count, seed);
+  parent->Iterate(si);
+}
+
+bool SampleTestSet::ParseSample(const std::string& s, unsigned& count)
+{
+  char* end;
+  if (s.empty() || s[0] < '0' || s[0] > '9') { return false; }
+  errno = 0;
+  unsigned long n = strtoul(s.c_str(), &end, 10);
+  if (*end || errno == ERANGE || n == 0 || n > UINT32_MAX) { return false; }
+  count = (unsigned) n;
+  return true;
+}
+
+bool SampleTestSet::ParseSeed(const std::string& s, uint64_t& seed)
+{
+  char* end;
+  if (s.empty() || s[0] < '0' || s[0] > '9') { return false; }
+  // Out of range values saturate, the run would not be reproduced from them.
+  errno = 0;
+  seed = strtoull(s.c_str(), &end, 10);
+  return *end == 0 && errno != ERANGE;
+}
+
 TestSet* OneTest::Filter(TestNameFilter* filter)
 {
   if (filter->Matches("", test)) {
@@ -245,7 +515,7 @@ TestSet* OneTest::Filter(ExcludeListFilter* filter)
 void TestSetUnion::InitContext(Context* context)
 {
   this->context = context;
-  for (std::unique_ptr<TestSet>& ts : testSets) {
+  for (TestSet* ts : testSets) {
     ts->InitContext(context);
   }
 }
@@ -258,37 +528,49 @@ bool CutTestNamePrefix(const std::string& name, std::string& prefix, std::string
   return true;
 }
 
+uint64_t TestNameHash(const std::string& fullTestName)
+{
+  return Hash64::Of(fullTestName);
+}
+
+std::string TestHashString(uint64_t hash)
+{
+  static const char digits[] = "0123456789abcdef";
+  std::string s(16, '0');
+  for (unsigned i = 16; i > 0; --i, hash >>= 4) {
+    s[i - 1] = digits[hash & 0xf];
+  }
+  return s;
+}
+
+uint64_t TestSpec::TestHash(const std::string& path) const
+{
+  // Same as TestNameHash(path + "/" + TestName()) without building the string.
+  return Hash64().Add(path).Add('/').Add(TestName()).Get();
+}
+
 TestSet* TestSetUnion::Filter(TestNameFilter* filter)
 {
-  std::string rest;
-  if (filter->NamePattern().empty()) { return this; }
-  if (!CutTestNamePrefix(filter->NamePattern(), base, rest)) { return new EmptyTestSet(); }
-  if (rest.empty()) { return this; }
-  TestNameFilter* filter1 = new TestNameFilter(rest);
+  TestNameFilter* filter1 = filter->Descend(base);
+  if (filter1->SelectsNone()) { delete filter1; return new EmptyTestSet(); }
+  if (filter1->SelectsAll()) { delete filter1; return this; }
   TestSetUnion* ts = new TestSetUnion(base);
   for (unsigned i = 0; i < testSets.size(); ++i) {
-    ts->Add(testSets[i]->Filter(filter1));
+    TestSet* fts = testSets[i]->Filter(filter1);
+    if (fts == testSets[i]) { ts->AddShared(fts); } else { ts->Add(fts); }
   }
   return ts;
 }
 
 TestSet* TestSetUnion::Filter(ExcludeListFilter* filter)
 {
-  std::string rest;
-  ExcludeListFilter* filter1 = new ExcludeListFilter();
-  for (std::string prefix : filter->ExcludePrefixes()) {
-    if (CutTestNamePrefix(prefix, base, rest)) {
-      if (rest.empty()) {
-        delete filter1;
-        return new EmptyTestSet();
-      } else {
-        filter1->AddPrefix(rest);
-      }
-    }
-  }
+  ExcludeListFilter* filter1 = filter->Descend(base);
+  if (filter1->ExcludesAll()) { delete filter1; return new EmptyTestSet(); }
+  if (filter1->ExcludesNone()) { delete filter1; return this; }
   TestSetUnion* ts = new TestSetUnion(base);
   for (unsigned i = 0; i < testSets.size(); ++i) {
-    ts->Add(testSets[i]->Filter(filter1));
+    TestSet* fts = testSets[i]->Filter(filter1);
+    if (fts == testSets[i]) { ts->AddShared(fts); } else { ts->Add(fts); }
   }
   return ts;
 }
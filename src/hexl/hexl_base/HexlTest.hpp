@@ -20,7 +20,9 @@
 #include "HexlContext.hpp"
 #include "Options.hpp"
 #include "Stats.hpp"
+#include "HexlTestPattern.hpp"
 
+#include <atomic>
 #include <string>
 #include <vector>
 #include <stdint.h>
@@ -54,14 +56,16 @@ class TestResult {
 private:
   TestStatus status;
   std::string output;
-  clock_t t_begin;
-  clock_t t_end;
+  uint64_t time;
+  PhaseTimes phases;
+  ValidationStats validation;
+  LatencyStats latency;
 
 public:
   TestResult()
-    : status(PASSED) { }
+    : status(PASSED), time(0) { }
   TestResult(TestStatus status_, const std::string& output_ = "")
-    : status(status_), output(output_) { }
+    : status(status_), output(output_), time(0) { }
   TestStatus Status() const { return status; }
   const char *StatusString() const { return TestStatusString(status); }
   void SetStatus(TestStatus status) { this->status = status; }
@@ -77,19 +81,35 @@ public:
   void SetOutput(const std::string& output) { this->output = output; }
   void Serialize(std::ostream& out) const;
   void Deserialize(std::istream& in);
-  void SetTime(clock_t begin, clock_t end) { t_begin = begin; t_end = end; }
-  float ExecutionTime() const { return ((float)(t_end - t_begin))/CLOCKS_PER_SEC; }
+  /// Wall-clock execution time in nanoseconds.
+  void SetTime(uint64_t time) { this->time = time; }
+  uint64_t Time() const { return time; }
+  float ExecutionTime() const { return (float) (time / 1e9); }
+  const PhaseTimes& Phases() const { return phases; }
+  void SetPhases(const PhaseTimes& phases) { this->phases = phases; }
+  const ValidationStats& Validation() const { return validation; }
+  void SetValidation(const ValidationStats& validation) { this->validation = validation; }
+  const LatencyStats& Latency() const { return latency; }
+  void SetLatency(const LatencyStats& latency) { this->latency = latency; }
 };
 
 ENUM_SERIALIZER(TestStatus);
 MEMBER_SERIALIZER(TestResult);
 
 class Test {
+private:
+  mutable std::atomic<std::string*> name;
+
 public:
-  virtual ~Test() { }
+  Test() : name(0) { }
+  virtual ~Test() { delete name.load(); }
   virtual std::string Type() const = 0;
   virtual void Name(std::ostream& out) const = 0;
-  std::string TestName() const;
+  /// Name() rendered on first call and kept until the test is deleted.
+  const std::string& TestName() const;
+  /// Number of TestName() calls and of Name() renderings by them.
+  static uint64_t NameLookups();
+  static uint64_t NameRenders();
   virtual void Description(std::ostream& out) const = 0;
   virtual void InitContext(Context* context) = 0;
   virtual Context* GetContext() = 0;
@@ -137,6 +157,8 @@ private:
 
 public:
   virtual void Name(std::ostream& out) const = 0;
+  /// TestNameHash() of the full name of this test under path.
+  uint64_t TestHash(const std::string& path) const;
   virtual Test* Create() = 0;
   virtual bool IsValid() const = 0;
   virtual void Run();
@@ -162,6 +184,39 @@ public:
 class TestSpecIterator {
 public:
   virtual void operator()(const std::string& path, TestSpec* spec) = 0;
+  /// Number of next tests, at most count, which are not needed by the
+  /// iterator. Test sets which can enumerate tests by index do not create
+  /// these tests and continue after them.
+  virtual uint64_t Skip(uint64_t count) { return 0; }
+  /// Strength t of covering arrays to reduce combinations of test
+  /// parameters to, so that every t-tuple of parameter values is still
+  /// tested. 0 means all combinations are tested.
+  virtual unsigned Coverage() { return 0; }
+  /// Context in which tests are checked for validity while choosing rows
+  /// of covering arrays, 0 if they are not checked.
+  virtual Context* CoverageContext() { return 0; }
+  /// Number of parameter combinations to draw at random from every
+  /// product of test parameters, 0 means all are tested. Draws depend
+  /// only on SampleSeed() and names of enclosing test sets.
+  virtual unsigned Sample() { return 0; }
+  virtual uint64_t SampleSeed() { return 0; }
+};
+
+/// Passes tests and all hooks on to another iterator. Iterators wrapping
+/// another one derive from it and override only what they change.
+class ForwardingTestSpecIterator : public TestSpecIterator {
+protected:
+  TestSpecIterator& it;
+
+public:
+  explicit ForwardingTestSpecIterator(TestSpecIterator& it_) : it(it_) { }
+
+  void operator()(const std::string& path, TestSpec* spec) override { it(path, spec); }
+  uint64_t Skip(uint64_t count) override { return it.Skip(count); }
+  unsigned Coverage() override { return it.Coverage(); }
+  Context* CoverageContext() override { return it.CoverageContext(); }
+  unsigned Sample() override { return it.Sample(); }
+  uint64_t SampleSeed() override { return it.SampleSeed(); }
 };
 
 class TestSpecList : public TestSpecIterator {
@@ -181,6 +236,23 @@ private:
   std::vector<TestSpec*> specs;
 };
 
+/// Full names of valid tests in iteration order, without creating tests
+/// from their specs.
+class TestNameList : public TestSpecIterator {
+private:
+  Context* context;
+  std::ostream* out;
+  size_t count;
+
+public:
+  /// Prints names to out, one per line, unless it is 0.
+  TestNameList(Context* context_, std::ostream* out_)
+    : context(context_), out(out_), count(0) { }
+
+  void operator()(const std::string& path, TestSpec* spec);
+  size_t Count() const { return count; }
+};
+
 class TestFilter;
 class TestNameFilter;
 class ExcludeListFilter;
@@ -247,6 +319,73 @@ public:
   virtual TestSet* Filter(ExcludeListFilter* filter);
 };
 
+/// Tests of parent test set with index % count == index, so that tests
+/// can be split between several runs.
+class ShardTestSet : public TestSet {
+private:
+  TestSet* parent;
+  unsigned index;
+  unsigned count;
+
+public:
+  ShardTestSet(TestSet* parent_, unsigned index_, unsigned count_)
+    : parent(parent_), index(index_), count(count_) { assert(index < count); }
+  virtual void InitContext(Context* context) { parent->InitContext(context); }
+  virtual void Name(std::ostream& out) const { parent->Name(out); }
+  virtual void Description(std::ostream& out) const { parent->Description(out); }
+  virtual void Iterate(TestSpecIterator& it);
+  virtual TestSet* Filter(TestNameFilter* filter);
+  virtual TestSet* Filter(ExcludeListFilter* filter);
+
+  /// Parses "index/count".
+  static bool ParseShard(const std::string& s, unsigned& index, unsigned& count);
+};
+
+/// Tests of parent test set with combinations of parameters of
+/// TestForEach reduced to covering arrays of given strength. Rows are
+/// chosen among tests valid in context, if it is given.
+class CoverageTestSet : public TestSet {
+private:
+  TestSet* parent;
+  unsigned strength;
+  Context* context;
+
+public:
+  CoverageTestSet(TestSet* parent_, unsigned strength_, Context* context_ = 0)
+    : parent(parent_), strength(strength_), context(context_) { assert(strength > 0); }
+  virtual void InitContext(Context* context) { this->context = context; parent->InitContext(context); }
+  virtual void Name(std::ostream& out) const { parent->Name(out); }
+  virtual void Description(std::ostream& out) const { parent->Description(out); }
+  virtual void Iterate(TestSpecIterator& it);
+  virtual TestSet* Filter(TestNameFilter* filter);
+  virtual TestSet* Filter(ExcludeListFilter* filter);
+
+  /// Parses "t=strength".
+  static bool ParseCoverage(const std::string& s, unsigned& strength);
+};
+
+/// Tests of parent test set with up to count combinations of parameters
+/// of every TestForEach drawn at random with given seed.
+class SampleTestSet : public TestSet {
+private:
+  TestSet* parent;
+  unsigned count;
+  uint64_t seed;
+
+public:
+  SampleTestSet(TestSet* parent_, unsigned count_, uint64_t seed_)
+    : parent(parent_), count(count_), seed(seed_) { assert(count > 0); }
+  virtual void InitContext(Context* context) { parent->InitContext(context); }
+  virtual void Name(std::ostream& out) const { parent->Name(out); }
+  virtual void Description(std::ostream& out) const { parent->Description(out); }
+  virtual void Iterate(TestSpecIterator& it);
+  virtual TestSet* Filter(TestNameFilter* filter);
+  virtual TestSet* Filter(ExcludeListFilter* filter);
+
+  static bool ParseSample(const std::string& s, unsigned& count);
+  static bool ParseSeed(const std::string& s, uint64_t& seed);
+};
+
 class OneTest : public TestSet {
 public:
   OneTest(Test* test_) : test(test_) { assert(test); }
@@ -266,7 +405,8 @@ private:
 class TestSetUnion : public TestSet {
 private:
   std::string base;
-  std::vector<std::unique_ptr<TestSet>> testSets;
+  std::vector<TestSet*> testSets;
+  std::vector<std::unique_ptr<TestSet>> ownTestSets;
 
 protected:
   Context* context;
@@ -275,7 +415,9 @@ public:
   TestSetUnion(const std::string& base_, Context* context_ = 0)
     : base(base_), context(context_) { }
   void InitContext(Context* context);
-  void Add(TestSet* testSet) { testSets.push_back(std::unique_ptr<TestSet>(testSet)); }
+  void Add(TestSet* testSet) { testSets.push_back(testSet); ownTestSets.push_back(std::unique_ptr<TestSet>(testSet)); }
+  /// Adds test set owned by another union, e.g. the one this union was filtered from.
+  void AddShared(TestSet* testSet) { testSets.push_back(testSet); }
   void Name(std::ostream& out) const { out << base; }
   void Description(std::ostream& out) const { out << base; }
   virtual void Iterate(TestSpecIterator& it);
@@ -296,30 +438,69 @@ public:
   virtual bool Matches(const std::string& path, Test* test) = 0;
 };
 
+/// Selects tests matching TestNamePattern. Filters created by Descend()
+/// for nested test sets share the compiled pattern and start at the state
+/// reached after their path.
 class TestNameFilter : public TestFilter {
 private:
-  std::string namePattern;
+  std::shared_ptr<TestNamePattern> pattern;
+  TestNamePattern::State state;
+
+  TestNameFilter(const std::shared_ptr<TestNamePattern>& pattern_, TestNamePattern::State state_)
+    : pattern(pattern_), state(state_) { }
 
 public:
-  TestNameFilter(const std::string& namePattern_)
-    : namePattern(namePattern_) { }
+  /// Invalid pattern selects no tests, see TestNamePattern::Compile.
+  TestNameFilter(const std::string& namePattern);
   virtual TestSet* Filter(TestSet* ts) { return ts->Filter(this); }
   bool Matches(const std::string& path, Test* test);
   bool Matches(const std::string& name);
-  const std::string& NamePattern() const { return namePattern; }
+
+  /// Filter for names relative to path base.
+  TestNameFilter* Descend(const std::string& base) const;
+  bool SelectsAll() const { return pattern->IsUniversal(state); }
+  bool SelectsNone() const { return pattern->IsDead(state); }
 };
 
+/// Excludes tests with names starting with any of the prefixes.
+///
+/// Prefixes are compiled into a character trie shared by the filter and
+/// filters created by Descend() for nested test sets, which start at the
+/// trie node of their path. A name is matched by walking it once,
+/// independent of the number of prefixes.
 class ExcludeListFilter : public TestFilter {
 private:
-  std::vector<std::string> excludePrefixes;
+  struct Node {
+    bool excluded;
+    std::vector<std::pair<char, unsigned>> next;
+    Node() : excluded(false) { }
+  };
+
+  static const unsigned NO_NODE = (unsigned) -1;
+
+  std::shared_ptr<std::vector<Node>> trie;
+  unsigned root;
+
+  ExcludeListFilter(const std::shared_ptr<std::vector<Node>>& trie_, unsigned root_)
+    : trie(trie_), root(root_) { }
+
+  /// Follows s from node. Stops at the first node ending a prefix.
+  unsigned Walk(unsigned node, const std::string& s) const;
+  bool IsExcluded(unsigned node) const { return node != NO_NODE && (*trie)[node].excluded; }
 
 public:
+  ExcludeListFilter() : trie(new std::vector<Node>(1)), root(0) { }
+
   virtual TestSet* Filter(TestSet* ts) { return ts->Filter(this); }
   bool Matches(const std::string& path, Test* test);
   bool Matches(const std::string& name);
-  const std::vector<std::string>& ExcludePrefixes() const { return excludePrefixes; }
-  void AddPrefix(const std::string& prefix) { excludePrefixes.push_back(prefix); }
+  void AddPrefix(const std::string& prefix);
   bool Load(ResourceManager* rm, const std::string& name);
+
+  /// Filter for names relative to path base.
+  ExcludeListFilter* Descend(const std::string& base) const;
+  bool ExcludesAll() const { return IsExcluded(root); }
+  bool ExcludesNone() const { return root == NO_NODE; }
 };
 
 class AndFilter : public TestFilter {
@@ -336,6 +517,13 @@ public:
 
 bool CutTestNamePrefix(const std::string& name, std::string& prefix, std::string& rest, bool allowPartial = false);
 
+/// Identifier of a test: 64-bit FNV-1a hash of its full name, which
+/// includes values of all test parameters. Depends only on the bytes of
+/// the name, so it is the same across runs and platforms.
+uint64_t TestNameHash(const std::string& fullTestName);
+/// Hash as 16 lowercase hex digits.
+std::string TestHashString(uint64_t hash);
+
 class AssemblyStats;
 
 class AllStats;
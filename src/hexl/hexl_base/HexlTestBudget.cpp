@@ -0,0 +1,206 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "HexlTestBudget.hpp"
+#include "HexlTestHistory.hpp"
+#include "HexlContext.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <unordered_map>
+#include <vector>
+
+namespace hexl {
+
+namespace {
+
+class BudgetCollector : public TestSpecIterator {
+private:
+  Context* context;
+  const TestHistory* history;
+  std::unordered_map<std::string, unsigned> paths;
+
+public:
+  std::vector<BudgetCandidate> candidates;
+  std::vector<uint64_t> hashes;
+
+  BudgetCollector(Context* context_, const TestHistory* history_)
+    : context(context_), history(history_) { }
+
+  void operator()(const std::string& path, TestSpec* spec) override
+  {
+    spec->InitContext(context);
+    if (spec->IsValid()) {
+      std::string fullTestName = path + "/" + spec->TestName();
+      BudgetCandidate c;
+      c.known = history->Find(fullTestName, c.time, c.failed);
+      if (!c.known) { c.time = 0; c.failed = false; }
+      c.path = paths.insert(std::make_pair(path, (unsigned) paths.size())).first->second;
+      c.selected = false;
+      candidates.push_back(c);
+      hashes.push_back(TestNameHash(fullTestName));
+    }
+    delete spec;
+  }
+
+  unsigned PathCount() const { return (unsigned) paths.size(); }
+};
+
+class BudgetIterator : public ForwardingTestSpecIterator {
+private:
+  const std::unordered_set<uint64_t>& hashes;
+
+public:
+  BudgetIterator(TestSpecIterator& it_, const std::unordered_set<uint64_t>& hashes_)
+    : ForwardingTestSpecIterator(it_), hashes(hashes_) { }
+
+  void operator()(const std::string& path, TestSpec* spec) override
+  {
+    if (hashes.count(spec->TestHash(path))) {
+      it(path, spec);
+    } else {
+      delete spec;
+    }
+  }
+
+  // Selected tests are not numbered like tests of the parent set.
+  uint64_t Skip(uint64_t count) override { return 0; }
+};
+
+}
+
+bool SelectWithinBudget(Context* context, std::vector<BudgetCandidate>& candidates, unsigned pathCount, uint64_t budget)
+{
+  std::vector<uint64_t> known;
+  for (const BudgetCandidate& c : candidates) {
+    if (c.known) { known.push_back(c.time); }
+  }
+  if (known.empty()) { return false; }
+  std::nth_element(known.begin(), known.begin() + known.size() / 2, known.end());
+  uint64_t median = known[known.size() / 2];
+  for (BudgetCandidate& c : candidates) {
+    if (!c.known) { c.time = median; }
+  }
+
+  uint64_t total = 0;
+  size_t count = 0;
+  auto take = [&](BudgetCandidate& c) {
+    if (c.time <= budget - total) {
+      total += c.time;
+      c.selected = true;
+      ++count;
+    }
+  };
+  auto cheaper = [&](unsigned i1, unsigned i2) {
+    return candidates[i1].time < candidates[i2].time || (candidates[i1].time == candidates[i2].time && i1 < i2);
+  };
+
+  // Tests failed in the last run first.
+  std::vector<unsigned> failed;
+  std::vector<std::vector<unsigned>> byPath(pathCount);
+  for (unsigned i = 0; i < candidates.size(); ++i) {
+    if (candidates[i].failed) {
+      failed.push_back(i);
+    } else {
+      byPath[candidates[i].path].push_back(i);
+    }
+  }
+  std::sort(failed.begin(), failed.end(), cheaper);
+  for (unsigned i : failed) { take(candidates[i]); }
+
+  // Then the cheapest remaining test of every path in turn.
+  std::vector<unsigned> active;
+  for (unsigned p = 0; p < byPath.size(); ++p) {
+    if (!byPath[p].empty()) {
+      std::sort(byPath[p].begin(), byPath[p].end(), cheaper);
+      active.push_back(p);
+    }
+  }
+  for (unsigned round = 0; !active.empty(); ++round) {
+    unsigned k = 0;
+    for (unsigned p : active) {
+      take(candidates[byPath[p][round]]);
+      if (round + 1 < byPath[p].size()) { active[k++] = p; }
+    }
+    active.resize(k);
+  }
+
+  if (context->IsVerbose("budget")) {
+    context->Info() << "Time budget: selected " << count << " of " << candidates.size() <<
+      " tests, estimated " << total / 1e9 << "s" << std::endl;
+  }
+  return true;
+}
+
+void BudgetTestSet::Select()
+{
+  selected = true;
+  TestHistory history(context);
+  if (historyName.empty() || !history.Load(historyName) || history.Count() == 0) {
+    selectAll = true;
+    return;
+  }
+  BudgetCollector collector(context, &history);
+  parent->Iterate(collector);
+  if (!SelectWithinBudget(context, collector.candidates, collector.PathCount(), budget)) {
+    selectAll = true;
+    return;
+  }
+  for (size_t i = 0; i < collector.candidates.size(); ++i) {
+    if (collector.candidates[i].selected) { hashes.insert(collector.hashes[i]); }
+  }
+}
+
+void BudgetTestSet::Iterate(TestSpecIterator& it)
+{
+  if (!selected) { Select(); }
+  if (selectAll) {
+    parent->Iterate(it);
+    return;
+  }
+  BudgetIterator bi(it, hashes);
+  parent->Iterate(bi);
+}
+
+TestSet* BudgetTestSet::Filter(TestNameFilter* filter)
+{
+  return new FilteredTestSet(this, filter);
+}
+
+TestSet* BudgetTestSet::Filter(ExcludeListFilter* filter)
+{
+  return new FilteredTestSet(this, filter);
+}
+
+bool BudgetTestSet::ParseBudget(const std::string& s, uint64_t& budget)
+{
+  char* end;
+  if (s.empty() || s[0] < '0' || s[0] > '9') { return false; }
+  uint64_t n = strtoull(s.c_str(), &end, 10);
+  uint64_t unit;
+  switch (*end) {
+  case 0: case 's': unit = 1; break;
+  case 'm': unit = 60; break;
+  case 'h': unit = 3600; break;
+  default: return false;
+  }
+  if (*end && end[1]) { return false; }
+  if (n == 0 || n > UINT64_MAX / 1000000000 / unit) { return false; }
+  budget = n * unit * 1000000000;
+  return true;
+}
+
+}
@@ -0,0 +1,87 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#ifndef HEXL_TEST_BUDGET_HPP
+#define HEXL_TEST_BUDGET_HPP
+
+#include "HexlTest.hpp"
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <stdint.h>
+
+namespace hexl {
+
+/// Test considered for a time budget.
+struct BudgetCandidate {
+  /// Duration in nanoseconds from test history, if known.
+  uint64_t time;
+  /// Index of test path of the test.
+  unsigned path;
+  bool known;
+  /// Test failed in the last run.
+  bool failed;
+  bool selected;
+};
+
+/// Marks candidates expected to complete within budget as selected, as
+/// described for BudgetTestSet. Returns false if duration of none of
+/// them is known, then all of them should be run.
+bool SelectWithinBudget(Context* context, std::vector<BudgetCandidate>& candidates, unsigned pathCount, uint64_t budget);
+
+/// Tests of parent test set expected to complete within a time budget.
+///
+/// Duration of every test is estimated from test history; tests missing
+/// from it are estimated with the median duration of the known ones.
+/// Tests which failed in the last run are selected first, cheapest first.
+/// The budget left is then spread over test paths round-robin, taking
+/// the cheapest remaining test of every path in turn, so that as many
+/// distinct instructions and types as possible are tested. Without
+/// history all tests are selected and only the runner deadline applies.
+/// With test workers the runner selects tests itself, see
+/// TestRunnerBase::RunPoolTests.
+class BudgetTestSet : public TestSet {
+private:
+  TestSet* parent;
+  Context* context;
+  uint64_t budget;
+  std::string historyName;
+  bool selected;
+  bool selectAll;
+  std::unordered_set<uint64_t> hashes;
+
+  void Select();
+
+public:
+  BudgetTestSet(TestSet* parent_, uint64_t budget_, const std::string& historyName_)
+    : parent(parent_), context(0), budget(budget_), historyName(historyName_),
+      selected(false), selectAll(false) { }
+  virtual void InitContext(Context* context) { this->context = context; parent->InitContext(context); }
+  virtual void Name(std::ostream& out) const { parent->Name(out); }
+  virtual void Description(std::ostream& out) const { parent->Description(out); }
+  virtual void Iterate(TestSpecIterator& it);
+  virtual TestSet* Filter(TestNameFilter* filter);
+  virtual TestSet* Filter(ExcludeListFilter* filter);
+
+  /// Parses duration like "90s", "20m" or "2h" to nanoseconds. Number
+  /// without suffix is seconds.
+  static bool ParseBudget(const std::string& s, uint64_t& budget);
+};
+
+}
+
+#endif // HEXL_TEST_BUDGET_HPP
@@ -0,0 +1,107 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "HexlTestHistory.hpp"
+#include "HexlContext.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#ifdef _WIN32
+#include <windows.h>
+#endif // _WIN32
+
+namespace hexl {
+
+bool TestHistory::Load(const std::string& name)
+{
+  this->name = name;
+  std::ifstream in(name.c_str());
+  if (!in.is_open()) { return true; }
+  std::string line;
+  unsigned lineNum = 0;
+  while (std::getline(in, line)) {
+    ++lineNum;
+    if (line.empty()) { continue; }
+    size_t pos = line.find(' ');
+    char* end = 0;
+    Entry e;
+    e.time = strtoull(line.c_str(), &end, 10);
+    e.failed = pos != std::string::npos && end == line.c_str() + pos - 1 && *end == '!';
+    if (pos == std::string::npos || (end != line.c_str() + pos && !e.failed)) {
+      context->Error() << name << ":" << lineNum << ": invalid test duration" << std::endl;
+      return false;
+    }
+    times[line.substr(pos + 1)] = e;
+  }
+  return true;
+}
+
+bool TestHistory::Save()
+{
+  if (!updated) { return true; }
+  std::string tmpName = name + ".tmp";
+  {
+    std::ofstream out(tmpName.c_str(), std::ofstream::out);
+    if (!out.is_open()) {
+      context->Error() << "Failed to open " << tmpName << std::endl;
+      return false;
+    }
+    for (auto& t : times) {
+      out << t.second.time << (t.second.failed ? "! " : " ") << t.first << "\n";
+    }
+    out.close();
+    if (out.fail()) {
+      context->Error() << "Failed to write " << tmpName << std::endl;
+      return false;
+    }
+  }
+#ifdef _WIN32
+  bool ok = MoveFileExA(tmpName.c_str(), name.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  bool ok = rename(tmpName.c_str(), name.c_str()) == 0;
+#endif // _WIN32
+  if (!ok) {
+    context->Error() << "Failed to replace " << name << std::endl;
+    return false;
+  }
+  updated = false;
+  return true;
+}
+
+bool TestHistory::Find(const std::string& fullTestName, uint64_t& time) const
+{
+  bool failed;
+  return Find(fullTestName, time, failed);
+}
+
+bool TestHistory::Find(const std::string& fullTestName, uint64_t& time, bool& failed) const
+{
+  auto i = times.find(fullTestName);
+  if (i == times.end()) { return false; }
+  time = i->second.time;
+  failed = i->second.failed;
+  return true;
+}
+
+void TestHistory::Update(const std::string& fullTestName, uint64_t time, bool failed)
+{
+  Entry& e = times[fullTestName];
+  e.time = time;
+  e.failed = failed;
+  updated = true;
+}
+
+}
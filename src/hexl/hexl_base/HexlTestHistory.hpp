@@ -0,0 +1,62 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef HEXL_TEST_HISTORY_HPP
+#define HEXL_TEST_HISTORY_HPP
+
+#include <map>
+#include <string>
+#include <stdint.h>
+
+namespace hexl {
+
+class Context;
+
+/// Durations of tests in previous runs, keyed by full test name.
+///
+/// Stored as a text file with a line "<nanoseconds> <full test name>"
+/// per test, or "<nanoseconds>! <full test name>" if the test failed
+/// in the last run. Save() merges durations of the current run into the
+/// loaded ones and replaces the file atomically.
+class TestHistory {
+private:
+  struct Entry {
+    uint64_t time;
+    bool failed;
+  };
+
+  Context* context;
+  std::string name;
+  std::map<std::string, Entry> times;
+  bool updated;
+
+public:
+  explicit TestHistory(Context* context_)
+    : context(context_), updated(false) { }
+
+  /// Loads durations from file. Missing file is the same as empty one.
+  bool Load(const std::string& name);
+  bool Save();
+
+  size_t Count() const { return times.size(); }
+  bool Find(const std::string& fullTestName, uint64_t& time) const;
+  bool Find(const std::string& fullTestName, uint64_t& time, bool& failed) const;
+  void Update(const std::string& fullTestName, uint64_t time, bool failed = false);
+};
+
+}
+
+#endif // HEXL_TEST_HISTORY_HPP
@@ -0,0 +1,170 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "HexlTestJournal.hpp"
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif // _WIN32
+
+namespace hexl {
+
+static const char JOURNAL_MAGIC[8] = { 'H', 'E', 'X', 'L', 'J', 'R', 'N', 'L' };
+static const uint32_t JOURNAL_VERSION = 2;
+
+bool TestJournal::Read(const std::string& name, uint64_t& validSize)
+{
+  validSize = 0;
+  std::ifstream in(name.c_str(), std::ios::in | std::ios::binary);
+  // Missing journal is the same as empty one.
+  if (!in.is_open()) { return true; }
+  std::ostringstream ss;
+  ss << in.rdbuf();
+  std::string data = ss.str();
+  if (data.empty()) { return true; }
+  const size_t headerSize = sizeof(JOURNAL_MAGIC) + sizeof(uint32_t);
+  uint32_t version = 0;
+  if (data.size() >= headerSize) {
+    memcpy(&version, data.data() + sizeof(JOURNAL_MAGIC), sizeof(version));
+  }
+  if (data.size() < headerSize ||
+      memcmp(data.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0 ||
+      version != JOURNAL_VERSION) {
+    context->Error() << "Invalid test journal " << name << std::endl;
+    return false;
+  }
+  size_t pos = headerSize;
+  while (data.size() - pos >= sizeof(uint32_t)) {
+    uint32_t length;
+    memcpy(&length, data.data() + pos, sizeof(length));
+    if (data.size() - pos - sizeof(length) < length) { break; }
+    std::istringstream s(data.substr(pos + sizeof(length), length));
+    pos += sizeof(length) + length;
+    std::string fullTestName;
+    Entry e;
+    ReadData(s, fullTestName);
+    ReadData(s, e.status);
+    ReadData(s, e.time);
+    entries[fullTestName] = e;
+  }
+  validSize = pos;
+  return true;
+}
+
+bool TestJournal::Load(const std::string& name)
+{
+  uint64_t validSize;
+  return Read(name, validSize);
+}
+
+bool TestJournal::Open(const std::string& name, bool resume)
+{
+  uint64_t validSize = 0;
+  if (resume && !Read(name, validSize)) { return false; }
+#ifdef _WIN32
+  fd = _open(name.c_str(), _O_WRONLY | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+  fd = open(name.c_str(), O_WRONLY | O_CREAT, 0644);
+#endif // _WIN32
+  if (fd < 0) {
+    context->Error() << "Failed to open test journal " << name << std::endl;
+    return false;
+  }
+  this->name = name;
+  // Drop torn last record of interrupted run.
+#ifdef _WIN32
+  if (_chsize_s(fd, validSize) != 0 || _lseeki64(fd, validSize, SEEK_SET) < 0) {
+#else
+  if (ftruncate(fd, validSize) != 0 || lseek(fd, validSize, SEEK_SET) < 0) {
+#endif // _WIN32
+    context->Error() << "Failed to truncate test journal " << name << std::endl;
+    Close();
+    return false;
+  }
+  if (validSize == 0) {
+    std::ostringstream s;
+    s.write(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    WriteData(s, JOURNAL_VERSION);
+    std::string header = s.str();
+#ifdef _WIN32
+    if (_write(fd, header.data(), (unsigned) header.size()) != (int) header.size()) {
+#else
+    if (write(fd, header.data(), header.size()) != (ssize_t) header.size()) {
+#endif // _WIN32
+      context->Error() << "Failed to write test journal " << name << std::endl;
+      Close();
+      return false;
+    }
+  }
+  return true;
+}
+
+void TestJournal::Close()
+{
+  if (fd >= 0) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif // _WIN32
+    fd = -1;
+  }
+}
+
+bool TestJournal::Find(const std::string& fullTestName, TestResult& result) const
+{
+  auto i = entries.find(fullTestName);
+  if (i == entries.end()) { return false; }
+  result = TestResult(i->second.status);
+  result.SetTime(i->second.time);
+  return true;
+}
+
+bool TestJournal::Append(const std::string& fullTestName, const TestResult& result)
+{
+  if (fd < 0) { return false; }
+  if (entries.find(fullTestName) != entries.end()) { return true; }
+  Entry e;
+  e.status = result.Status();
+  e.time = result.Time();
+  std::ostringstream s;
+  WriteData(s, fullTestName);
+  WriteData(s, e.status);
+  WriteData(s, e.time);
+  std::string data = s.str();
+  uint32_t length = (uint32_t) data.size();
+  data.insert(0, reinterpret_cast<const char*>(&length), sizeof(length));
+#ifdef _WIN32
+  bool ok = _write(fd, data.data(), (unsigned) data.size()) == (int) data.size() && _commit(fd) == 0;
+#else
+  bool ok = write(fd, data.data(), data.size()) == (ssize_t) data.size() && fsync(fd) == 0;
+#endif // _WIN32
+  if (!ok) {
+    context->Error() << "Failed to write test journal " << name << std::endl;
+    return false;
+  }
+  entries[fullTestName] = e;
+  return true;
+}
+
+}
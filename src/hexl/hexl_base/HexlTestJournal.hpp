@@ -0,0 +1,65 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef HEXL_TEST_JOURNAL_HPP
+#define HEXL_TEST_JOURNAL_HPP
+
+#include "HexlTest.hpp"
+#include <map>
+#include <string>
+
+namespace hexl {
+
+/// Append-only journal of completed tests.
+///
+/// Each record holds full test name, status and execution time of a test.
+/// Records are length-prefixed and every append is synced to disk, so after
+/// an interrupted run the journal contains all completed tests except
+/// possibly a torn last record, which is dropped when the journal is read.
+class TestJournal {
+private:
+  struct Entry {
+    TestStatus status;
+    uint64_t time;
+  };
+
+  Context* context;
+  std::string name;
+  int fd;
+  std::map<std::string, Entry> entries;
+
+  bool Read(const std::string& name, uint64_t& validSize);
+
+public:
+  explicit TestJournal(Context* context_)
+    : context(context_), fd(-1) { }
+  ~TestJournal() { Close(); }
+
+  /// Loads completed tests from journal file.
+  bool Load(const std::string& name);
+  /// Opens journal file for appending. If resume is set, completed tests
+  /// are loaded from existing file, otherwise it is truncated.
+  bool Open(const std::string& name, bool resume);
+  void Close();
+
+  size_t Count() const { return entries.size(); }
+  bool Find(const std::string& fullTestName, TestResult& result) const;
+  bool Append(const std::string& fullTestName, const TestResult& result);
+};
+
+}
+
+#endif // HEXL_TEST_JOURNAL_HPP
@@ -17,8 +17,9 @@
 #include "HexlTestList.hpp"
 #include "HexlResource.hpp"
 #include "HexlTestFactory.hpp"
-#include <set>
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 
 namespace hexl {
 
@@ -45,7 +46,7 @@ private:
 };
 
 
-#define TEMP_DEBUG_KEYS_(text) //text
+static bool IsBlank(char c) { return c == ' ' || c == '\t'; }
 
 /// Parses a line from testlist and returns results.
 /// Result could be testname with optional keywords OR
@@ -56,103 +57,99 @@ private:
 ///   One or more whitespaces or commas work as a separator between keywords.
 ///   Whitespaces and commas are not allowed in basename and keywords.
 ///
+/// Line is parsed in place in a single pass; keywords are set in
+/// lineKeywords.
+///
 /// \param:out  testname        Name of specified test or empty,
 ///                             if line does not specify any test.
-/// \param:out  keywords        Set of keywords associated with test.
-///                             Undefined if testname is empty.
 /// \param:out  nestedTestlist  Name of nested testlist or empty,
 ///                             if line does not specify nested testlist.
 /// \return     true = OK, false = failed
 ///
 bool SimpleTestList::Parse(
-  std::string line, 
+  const char* line,
+  const char* lineEnd,
   const unsigned lineNumber, // for diagnostics
   const std::string& testlist, // for diagnostics
-  std::string * const testname, 
-  std::set<std::string> * const keywords,
-  std::string * const nestedTestlist) const
+  std::string * const testname,
+  std::string * const nestedTestlist)
 {
-  assert(testname && keywords && nestedTestlist);
+  assert(testname && nestedTestlist);
   testname->clear();
-  keywords->clear();
   nestedTestlist->clear();
-  TEMP_DEBUG_KEYS_( std::string origLine = line; )
+  std::fill(lineKeywords.begin(), lineKeywords.end(), 0);
   // throw away everything which begins with [" "]*#
-  std::size_t e = line.find("#");
-  std::size_t s;
-  if ( e != std::string::npos ) {
-    if (e > 0) {
-      s = line.find_last_not_of(" \t", e-1, line.length()-e);
-      s = (s == std::string::npos) ? e : s+1;
-    } else {
-      s = e;
-    }
-    line.replace(s, line.length() - s, "");
-  }
+  const char* end = static_cast<const char*>(memchr(line, '#', lineEnd - line));
+  if (!end) { end = lineEnd; }
+  while (end > line && IsBlank(end[-1])) { --end; }
   // find testname or nestedTestlist
-  s = line.find_first_not_of(" \t");
-  if (s == std::string::npos) {
-    TEMP_DEBUG_KEYS_( std::cout << "   SKIPPED line " << lineNumber << ": \""<< origLine << "\"" << std::endl; ) 
-    return true;
-  } // nothing
-  e = line.find_first_of(" \t", s);
-  std::string token = std::string(line, s, (e == std::string::npos) ? e : e-s);
-  if (token.find(",") != std::string::npos) { // comma may get into testname in wrong lines
-    std::cout << "Error: Misplaced comma. Line " << lineNumber << " in testlist '" << testlist <<"': \""<< line << "\"" << std::endl; /// \todo
-    return false; 
+  const char* s = line;
+  while (s < end && IsBlank(*s)) { ++s; }
+  if (s == end) { return true; } // nothing
+  const char* e = s;
+  while (e < end && !IsBlank(*e)) { ++e; }
+  if (memchr(s, ',', e - s)) { // comma may get into testname in wrong lines
+    std::cout << "Error: Misplaced comma. Line " << lineNumber << " in testlist '" << testlist <<"': \""<< std::string(line, end) << "\"" << std::endl; /// \todo
+    return false;
   }
+  const char* rest = e;
+  while (rest < end && IsBlank(*rest)) { ++rest; }
 
-  std::string keywords_;
-  if (token[0] == '@') {
-    *nestedTestlist = std::string(token,1);
+  if (*s == '@') {
     // check that no extra characters in line
-    s = line.find_first_not_of(" \t", e);
-    if (s != std::string::npos) {
-      std::cout << "Error: Extra characters after testlist name: '" << std::string(line, s) << "'. Line " << lineNumber << " in testlist " << testlist <<": \""<< line << "\"" << std::endl; /// \todo
+    if (rest != end) {
+      std::cout << "Error: Extra characters after testlist name: '" << std::string(rest, end) << "'. Line " << lineNumber << " in testlist " << testlist <<": \""<< std::string(line, end) << "\"" << std::endl; /// \todo
       return false;
     }
-  } else {
-    *testname = token;
-    // find keywords_ and check the rest
-    s = line.find_first_not_of(" \t", e);
-    if (s != std::string::npos) {
-      e = line.find_first_of(" \t", s);
-      keywords_ = std::string(line, s, (e == std::string::npos) ? e : e-s);
-      s = line.find_first_not_of(" \t", e);
-      if (s != std::string::npos) {
-        std::cout << "Error: Extra characters after keywords: '" << std::string(line, s) << "'. Line " << lineNumber << " in testlist " << testlist <<": \""<< line << "\"" << std::endl; /// \todo
-        return false;
-      }
-    }
+    nestedTestlist->assign(s + 1, e);
+    return true;
+  }
+  testname->assign(s, e);
+  if (rest == end) { return true; }
+  // find keywords and check the rest
+  const char* keywordsEnd = rest;
+  while (keywordsEnd < end && !IsBlank(*keywordsEnd)) { ++keywordsEnd; }
+  s = keywordsEnd;
+  while (s < end && IsBlank(*s)) { ++s; }
+  if (s != end) {
+    std::cout << "Error: Extra characters after keywords: '" << std::string(s, end) << "'. Line " << lineNumber << " in testlist " << testlist <<": \""<< std::string(line, end) << "\"" << std::endl; /// \todo
+    return false;
   }
   // parse keywords
-  for (e = 0, s = 0; !keywords_.empty() && e != std::string::npos; s = e+1) {
-    e = keywords_.find(",", s);
-    std::string k = std::string(keywords_, s, (e == std::string::npos) ? e : e-s);
-    if (k.empty()) {
-      std::cout << "Error: Empty keyword. Line " << lineNumber << " in testlist '" << testlist <<"': \""<< line << "\"" << std::endl; /// \todo
+  for (s = rest; ; s = e + 1) {
+    e = static_cast<const char*>(memchr(s, ',', keywordsEnd - s));
+    if (!e) { e = keywordsEnd; }
+    if (e == s) {
+      std::cout << "Error: Empty keyword. Line " << lineNumber << " in testlist '" << testlist <<"': \""<< std::string(line, end) << "\"" << std::endl; /// \todo
       return false;
     }
-    keywords->insert(k);
-  }
-  TEMP_DEBUG_KEYS_(
-  std::cout << "   NESTED TL: " << *nestedTestlist << std::endl;
-  std::cout << "   TEST NAME: " << *testname << std::endl;
-  std::cout << "   KEYWORDS : ";
-  for (std::set<std::string>::const_iterator p = keywords->begin(); p != keywords->end(); ++p) {
-    std::cout << "[" << *p << "] ";
+    unsigned id = KeywordId(s, e - s);
+    lineKeywords[id / 64] |= (uint64_t) 1 << (id % 64);
+    if (e == keywordsEnd) { break; }
   }
-  std::cout << std::endl; )
   return true;
 }
 
-bool SimpleTestList::IsMatchKey(const std::set<std::string>& keywords) const
+unsigned SimpleTestList::KeywordId(const char* s, size_t length)
+{
+  // Reused string, so that known keywords are looked up without allocation.
+  keywordName.assign(s, length);
+  auto i = keywordIds.find(keywordName);
+  if (i != keywordIds.end()) { return i->second; }
+  unsigned id = (unsigned) keywordIds.size();
+  keywordIds.insert(std::make_pair(keywordName, id));
+  if (lineKeywords.size() <= id / 64) { lineKeywords.push_back(0); }
+  return id;
+}
+
+bool SimpleTestList::IsMatchKey() const
 {
   if (!key.empty()) {
-    if (key[0] == '!') { // there should be NONE matching keywords
-      if (keywords.count(std::string(key,1)) != 0) { return false; }
+    bool found = (lineKeywords[keyId / 64] >> (keyId % 64)) & 1;
+    if (keyNegated) { // there should be NONE matching keywords
+      if (found) { return false; }
     } else { // there should be at least ONE matching keyword
-      if (keywords.count(key) == 0) { return false; }
+      if (!found) { return false; }
     }
   }
   return true;
@@ -163,6 +160,11 @@ bool SimpleTestList::IsMatchKey(const std::set<std::string>& keywords) const
 bool SimpleTestList::ReadFrom(ResourceManager* rm, const std::string& testlist)
 {
   readFromNestingDepth = 0;
+  if (!key.empty()) {
+    keyNegated = key[0] == '!';
+    std::string k = keyNegated ? std::string(key, 1) : key;
+    keyId = KeywordId(k.data(), k.length());
+  }
   return ReadFromImpl(rm, testlist);
 }
 
@@ -171,38 +173,42 @@ bool SimpleTestList::ReadFromImpl(ResourceManager* rm, const std::string& testli
   assert(rm);
   ++readFromNestingDepth;
   bool rc = true;
-  std::istream* in = rm->Get(testlist); // new
-  if (!in) {
+  ResourceData* data = rm->GetData(testlist); // new
+  if (!data) {
     std::cout << "Error: Unable to open testlist '" << testlist <<"'" << std::endl; /// \todo
     rc = false;
   } else {
-    std::string line;
-    for (unsigned lineNumber = 1; getline(*in, line); ++lineNumber) {
-      std::string testname;
-      std::string nestedTestlist;
-      std::set<std::string> keywords;
-      if (!Parse(line, lineNumber, testlist, &testname, &keywords, &nestedTestlist)) {
+    const char* p = data->Data();
+    const char* end = p + data->Size();
+    std::string testname;
+    std::string nestedTestlist;
+    for (unsigned lineNumber = 1; p < end; ++lineNumber) {
+      const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+      const char* line = p;
+      const char* lineEnd = eol ? eol : end;
+      p = eol ? eol + 1 : end;
+      if (!Parse(line, lineEnd, lineNumber, testlist, &testname, &nestedTestlist)) {
         continue; // bad line, skip
       }
       if (!nestedTestlist.empty()) {
         if (readFromNestingDepth > 100) {
-          std::cout << "Error: Testlist nesting depth > 100. Line " << lineNumber << " in testlist '" << testlist <<"': \""<< line << "\"" << std::endl; /// \todo
+          std::cout << "Error: Testlist nesting depth > 100. Line " << lineNumber << " in testlist '" << testlist <<"': \""<< std::string(line, lineEnd) << "\"" << std::endl; /// \todo
           rc = false;
           break;
         }
         if (! (rc = ReadFromImpl(rm, nestedTestlist))) {
-          std::cout << "Info: See line " << lineNumber << " in testlist '" << testlist <<"': \""<< line << "\"" << std::endl; /// \todo
+          std::cout << "Info: See line " << lineNumber << " in testlist '" << testlist <<"': \""<< std::string(line, lineEnd) << "\"" << std::endl; /// \todo
           break;
         }
       } else if (!testname.empty()) {
-        if (IsMatchKey(keywords)) {
+        if (IsMatchKey()) {
           testNames.push_back(testname);
         }
       } else {
         continue;  // nothing in line, skip
       }
     }
-    delete in;
+    delete data;
   }
   --readFromNestingDepth;
   return rc;
@@ -19,7 +19,8 @@
 
 #include "HexlTest.hpp"
 #include <vector>
-#include <set>
+#include <unordered_map>
+#include <stdint.h>
 
 namespace hexl {
 
@@ -29,13 +30,15 @@ class TestFactory;
 class SimpleTestList : public TestSet {
 public:
   SimpleTestList(const std::string& name_, TestFactory* testFactory_, const std::string& testType_, const std::string& key_)
-    : name(name_), testFactory(testFactory_), testType(testType_), key(key_) { }
+    : name(name_), testFactory(testFactory_), testType(testType_), key(key_),
+      keyId(0), keyNegated(false) { }
   void Iterate(TestSpecIterator& it);
   void InitContext(Context *context) { }
   void Name(std::ostream& out) const { out << name; }
   void Description(std::ostream& out) const { out << name; }
   void Name(TestSpec* test, std::ostream& out) const { out << name << ":"; test->Name(out); }
   void AddTest(const std::string& name) { testNames.push_back(name); }
+  size_t TestCount() const { return testNames.size(); }
   bool ReadFrom(ResourceManager* rm, const std::string& name);
   TestSet* Filter(TestNameFilter* filter) { return new FilteredTestSet(this, filter); }
   TestSet* Filter(ExcludeListFilter* filter) { return new FilteredTestSet(this, filter); }
@@ -47,11 +50,19 @@ private:
   std::string testType;
   const std::string key;
   int readFromNestingDepth;
+  /// Keywords are interned to bit numbers of lineKeywords, the bitset of
+  /// keywords of the line being parsed.
+  std::unordered_map<std::string, unsigned> keywordIds;
+  std::string keywordName;
+  std::vector<uint64_t> lineKeywords;
+  unsigned keyId;
+  bool keyNegated;
   
   bool ReadFromImpl(ResourceManager* rm, const std::string& name);
-  bool Parse(std::string line, const unsigned lineNumber, const std::string& testlist, std::string * const testname,
-             std::set<std::string> * const keywords, std::string * const nestedTestlist) const;
-  bool IsMatchKey(const std::set<std::string>& keywords) const;
+  bool Parse(const char* line, const char* lineEnd, const unsigned lineNumber, const std::string& testlist,
+             std::string * const testname, std::string * const nestedTestlist);
+  unsigned KeywordId(const char* s, size_t length);
+  bool IsMatchKey() const;
   
   friend class SimpleTestSpec;
 };
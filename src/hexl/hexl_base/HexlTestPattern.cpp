@@ -0,0 +1,412 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "HexlTestPattern.hpp"
+#include <algorithm>
+#include <bitset>
+#include <cctype>
+#include <map>
+#include <cassert>
+
+namespace hexl {
+
+namespace {
+
+// Limit on DFA size, so that a pathological pattern is reported instead
+// of compiled for a long time.
+const size_t MAX_DFA_STATES = 4096;
+
+class Nfa {
+public:
+  struct Node {
+    std::bitset<256> chars;
+    unsigned out;
+    std::vector<unsigned> eps;
+  };
+
+  struct Fragment {
+    unsigned start;
+    unsigned end;
+  };
+
+  std::vector<Node> nodes;
+
+  unsigned AddNode() { nodes.push_back(Node()); return (unsigned) nodes.size() - 1; }
+  void AddEps(unsigned from, unsigned to) { nodes[from].eps.push_back(to); }
+
+  Fragment Chars(const std::bitset<256>& chars)
+  {
+    Fragment f;
+    f.start = AddNode();
+    f.end = AddNode();
+    nodes[f.start].chars = chars;
+    nodes[f.start].out = f.end;
+    return f;
+  }
+
+  Fragment Empty()
+  {
+    Fragment f;
+    f.start = f.end = AddNode();
+    return f;
+  }
+
+  Fragment Concat(Fragment a, Fragment b)
+  {
+    AddEps(a.end, b.start);
+    a.end = b.end;
+    return a;
+  }
+
+  Fragment Alt(Fragment a, Fragment b)
+  {
+    Fragment f;
+    f.start = AddNode();
+    f.end = AddNode();
+    AddEps(f.start, a.start);
+    AddEps(f.start, b.start);
+    AddEps(a.end, f.end);
+    AddEps(b.end, f.end);
+    return f;
+  }
+
+  Fragment Repeat(Fragment a, bool zero, bool many)
+  {
+    Fragment f;
+    f.start = AddNode();
+    f.end = AddNode();
+    AddEps(f.start, a.start);
+    AddEps(a.end, f.end);
+    if (zero) { AddEps(f.start, f.end); }
+    if (many) { AddEps(a.end, a.start); }
+    return f;
+  }
+
+  void Closure(std::vector<unsigned>& set) const
+  {
+    std::vector<unsigned> work(set);
+    std::vector<bool> seen(nodes.size());
+    for (unsigned n : set) { seen[n] = true; }
+    while (!work.empty()) {
+      unsigned n = work.back();
+      work.pop_back();
+      for (unsigned e : nodes[n].eps) {
+        if (!seen[e]) { seen[e] = true; set.push_back(e); work.push_back(e); }
+      }
+    }
+    std::sort(set.begin(), set.end());
+  }
+};
+
+// Recursive descent parser of regular expressions:
+// alternation '|', grouping '()', repetition '*', '+', '?', any character
+// '.', character classes '[a-z]' and '[^/]', and escapes '\c'.
+class RegexParser {
+private:
+  Nfa& nfa;
+  const std::string& s;
+  size_t pos;
+  std::string& error;
+
+  bool AtEnd() const { return pos >= s.length(); }
+
+  bool Fail(const std::string& msg)
+  {
+    if (error.empty()) { error = msg + " at position " + std::to_string(pos); }
+    return false;
+  }
+
+  bool ParseClass(std::bitset<256>& chars)
+  {
+    assert(s[pos] == '[');
+    ++pos;
+    bool negate = !AtEnd() && s[pos] == '^';
+    if (negate) { ++pos; }
+    bool first = true;
+    while (!AtEnd() && (first || s[pos] != ']')) {
+      first = false;
+      unsigned char lo = s[pos++];
+      if (lo == '\\' && !AtEnd()) { lo = s[pos++]; }
+      unsigned char hi = lo;
+      if (pos + 1 < s.length() && s[pos] == '-' && s[pos + 1] != ']') {
+        hi = s[pos + 1];
+        pos += 2;
+        if (hi == '\\' && !AtEnd()) { hi = s[pos++]; }
+        if (hi < lo) { return Fail("invalid character range"); }
+      }
+      for (unsigned c = lo; c <= hi; ++c) { chars.set(c); }
+    }
+    if (AtEnd()) { return Fail("missing ']'"); }
+    ++pos;
+    if (negate) { chars.flip(); }
+    return true;
+  }
+
+  bool ParseAtom(Nfa::Fragment& f)
+  {
+    std::bitset<256> chars;
+    char c = s[pos];
+    switch (c) {
+    case '(':
+      ++pos;
+      if (!ParseAlt(f)) { return false; }
+      if (AtEnd() || s[pos] != ')') { return Fail("missing ')'"); }
+      ++pos;
+      return true;
+    case '[':
+      if (!ParseClass(chars)) { return false; }
+      break;
+    case '.':
+      ++pos;
+      chars.set();
+      break;
+    case '\\':
+      ++pos;
+      if (AtEnd()) { return Fail("trailing '\\'"); }
+      chars.set((unsigned char) s[pos++]);
+      break;
+    case '*': case '+': case '?':
+      return Fail("nothing to repeat");
+    case '{': case '}':
+      return Fail("counted repetition is not supported");
+    default:
+      ++pos;
+      chars.set((unsigned char) c);
+      break;
+    }
+    f = nfa.Chars(chars);
+    return true;
+  }
+
+  bool ParseConcat(Nfa::Fragment& f)
+  {
+    f = nfa.Empty();
+    while (!AtEnd() && s[pos] != '|' && s[pos] != ')') {
+      Nfa::Fragment a;
+      if (!ParseAtom(a)) { return false; }
+      while (!AtEnd() && (s[pos] == '*' || s[pos] == '+' || s[pos] == '?')) {
+        char r = s[pos++];
+        a = nfa.Repeat(a, r != '+', r != '?');
+      }
+      f = nfa.Concat(f, a);
+    }
+    return true;
+  }
+
+  bool ParseAlt(Nfa::Fragment& f)
+  {
+    if (!ParseConcat(f)) { return false; }
+    while (!AtEnd() && s[pos] == '|') {
+      ++pos;
+      Nfa::Fragment b;
+      if (!ParseConcat(b)) { return false; }
+      f = nfa.Alt(f, b);
+    }
+    return true;
+  }
+
+public:
+  RegexParser(Nfa& nfa_, const std::string& s_, std::string& error_)
+    : nfa(nfa_), s(s_), pos(0), error(error_) { }
+
+  bool Parse(Nfa::Fragment& f)
+  {
+    if (!ParseAlt(f)) { return false; }
+    if (!AtEnd()) { return Fail("unmatched ')'"); }
+    return true;
+  }
+};
+
+bool IsGlob(const std::string& pattern)
+{
+  return pattern.find_first_of("*?[") != std::string::npos;
+}
+
+void AppendLiteral(std::string& regex, char c)
+{
+  if (!isalnum((unsigned char) c)) { regex += '\\'; }
+  regex += c;
+}
+
+std::string GlobToRegex(const std::string& glob)
+{
+  std::string regex;
+  for (size_t i = 0; i < glob.length(); ++i) {
+    char c = glob[i];
+    if (c == '*') {
+      if (i + 1 < glob.length() && glob[i + 1] == '*') {
+        regex += ".*";
+        ++i;
+      } else {
+        regex += "[^/]*";
+      }
+    } else if (c == '?') {
+      regex += "[^/]";
+    } else if (c == '[') {
+      size_t end = glob.find(']', i + 2);
+      if (end == std::string::npos) { AppendLiteral(regex, c); continue; }
+      regex += '[';
+      size_t j = i + 1;
+      if (glob[j] == '!' || glob[j] == '^') { regex += '^'; ++j; }
+      regex.append(glob, j, end - j + 1);
+      i = end;
+    } else {
+      AppendLiteral(regex, c);
+    }
+  }
+  return regex;
+}
+
+}
+
+const TestNamePattern::State TestNamePattern::DEAD;
+const TestNamePattern::State TestNamePattern::ALL;
+
+TestNamePattern::TestNamePattern()
+  : start(DEAD), next(2 * 256, DEAD), flags(2, 0)
+{
+  std::fill(next.begin() + ALL * 256, next.end(), ALL);
+  flags[ALL] = ACCEPT | LIVE | UNIVERSAL;
+}
+
+bool TestNamePattern::Compile(const std::string& pattern, std::string& error)
+{
+  std::string regex;
+  if (!pattern.empty() && pattern[0] == '^') {
+    regex = pattern.substr(1);
+    if (!regex.empty() && regex[regex.length() - 1] == '$' &&
+        (regex.length() < 2 || regex[regex.length() - 2] != '\\')) {
+      regex.erase(regex.length() - 1);
+    }
+  } else {
+    // Test names do not start with '/', "/" selects all tests.
+    size_t first = pattern.find_first_not_of('/');
+    std::string p = first == std::string::npos ? "" : pattern.substr(first);
+    if (IsGlob(p)) {
+      regex = GlobToRegex(p);
+    } else {
+      for (char c : p) { AppendLiteral(regex, c); }
+      regex += ".*";
+    }
+  }
+
+  Nfa nfa;
+  Nfa::Fragment f;
+  RegexParser parser(nfa, regex, error);
+  if (!parser.Parse(f)) {
+    error = "Invalid test pattern '" + pattern + "': " + error;
+    return false;
+  }
+
+  // Subset construction. DEAD is the empty set of NFA nodes, ALL has no
+  // set and is only entered by Enter().
+  std::map<std::vector<unsigned>, State> states;
+  std::vector<std::vector<unsigned>> sets(2);
+  states[sets[DEAD]] = DEAD;
+  next.resize(2 * 256);
+  flags.resize(2);
+  std::vector<unsigned> init(1, f.start);
+  nfa.Closure(init);
+  start = (State) sets.size();
+  states[init] = start;
+  sets.push_back(init);
+  for (size_t s = start; s < sets.size(); ++s) {
+    next.resize((s + 1) * 256, DEAD);
+    flags.push_back(std::binary_search(sets[s].begin(), sets[s].end(), f.end) ? ACCEPT : 0);
+    for (unsigned c = 0; c < 256; ++c) {
+      std::vector<unsigned> target;
+      for (unsigned n : sets[s]) {
+        if (nfa.nodes[n].chars.test(c)) { target.push_back(nfa.nodes[n].out); }
+      }
+      if (target.empty()) { continue; }
+      nfa.Closure(target);
+      target.erase(std::unique(target.begin(), target.end()), target.end());
+      auto i = states.find(target);
+      State t;
+      if (i != states.end()) {
+        t = i->second;
+      } else {
+        if (sets.size() >= MAX_DFA_STATES) {
+          error = "Invalid test pattern '" + pattern + "': pattern is too complex";
+          return false;
+        }
+        t = (State) sets.size();
+        states[target] = t;
+        sets.push_back(target);
+      }
+      next[s * 256 + c] = t;
+    }
+  }
+
+  // Live states reach an accepting one; universal states and all states
+  // they reach are accepting.
+  size_t count = sets.size();
+  std::vector<std::vector<State>> prev(count);
+  for (State s = 0; s < count; ++s) {
+    for (unsigned c = 0; c < 256; ++c) { prev[next[s * 256 + c]].push_back(s); }
+  }
+  std::vector<State> work;
+  for (State s = 0; s < count; ++s) {
+    if (flags[s] & ACCEPT) { flags[s] |= LIVE; work.push_back(s); }
+  }
+  while (!work.empty()) {
+    State s = work.back();
+    work.pop_back();
+    for (State p : prev[s]) {
+      if (!(flags[p] & LIVE)) { flags[p] |= LIVE; work.push_back(p); }
+    }
+  }
+  for (State s = 0; s < count; ++s) {
+    if (flags[s] & ACCEPT) { flags[s] |= UNIVERSAL; }
+  }
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (State s = 0; s < count; ++s) {
+      if (!(flags[s] & UNIVERSAL)) { continue; }
+      for (unsigned c = 0; c < 256; ++c) {
+        if (!(flags[next[s * 256 + c]] & UNIVERSAL)) {
+          flags[s] &= ~UNIVERSAL;
+          changed = true;
+          break;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+TestNamePattern::State TestNamePattern::Walk(State s, const std::string& str) const
+{
+  for (char c : str) {
+    if (s == DEAD) { break; }
+    s = Step(s, c);
+  }
+  return s;
+}
+
+bool TestNamePattern::Matches(State s, const std::string& name) const
+{
+  for (char c : name) {
+    if (IsUniversal(s)) { return true; }
+    if (IsDead(s)) { return false; }
+    if (c == '/' && IsAccepting(s)) { return true; }
+    s = Step(s, c);
+  }
+  return IsAccepting(s);
+}
+
+}
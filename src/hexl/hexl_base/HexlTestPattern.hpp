@@ -0,0 +1,79 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef HEXL_TEST_PATTERN_HPP
+#define HEXL_TEST_PATTERN_HPP
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace hexl {
+
+/// Pattern selecting tests by full name, compiled to a DFA.
+///
+/// A pattern is either a literal prefix (e.g. "prm/core/"), a glob
+/// where '*' and '?' do not match '/' and '**' matches anything
+/// (e.g. "prm/core/*/atomic*/*_u64_*"), or an anchored regular
+/// expression starting with '^'. Globs and regular expressions select
+/// a test if they match its full name or the path of one of the test
+/// sets containing it.
+///
+/// Names are matched incrementally: a state reached after the path of
+/// a test set tells whether all, none or some of its tests are selected.
+class TestNamePattern {
+public:
+  typedef uint32_t State;
+
+  /// States selecting no names and all names.
+  static const State DEAD = 0;
+  static const State ALL = 1;
+
+  TestNamePattern();
+
+  /// Compiles the pattern. Returns false and sets error if it is invalid.
+  bool Compile(const std::string& pattern, std::string& error);
+
+  State Start() const { return start; }
+  State Step(State s, char c) const { return next[s * 256 + (unsigned char) c]; }
+  State Walk(State s, const std::string& str) const;
+  /// Moves from path of a test set to names of tests in it.
+  State Enter(State s) const { return IsAccepting(s) ? ALL : Step(s, '/'); }
+  /// Name or path ending in this state (and followed by '/') is selected.
+  bool IsAccepting(State s) const { return (flags[s] & ACCEPT) != 0; }
+  /// Every name continuing from this state is selected.
+  bool IsUniversal(State s) const { return (flags[s] & UNIVERSAL) != 0; }
+  /// No name continuing from this state is selected.
+  bool IsDead(State s) const { return (flags[s] & LIVE) == 0; }
+
+  /// Whether name continuing from state s is selected.
+  bool Matches(State s, const std::string& name) const;
+
+private:
+  enum {
+    ACCEPT = 1,
+    LIVE = 2,
+    UNIVERSAL = 4
+  };
+
+  State start;
+  std::vector<State> next;
+  std::vector<uint8_t> flags;
+};
+
+}
+
+#endif // HEXL_TEST_PATTERN_HPP
@@ -0,0 +1,634 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "HexlTestPool.hpp"
+#include "Arena.hpp"
+#include "RuntimeCommon.hpp"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#endif // _WIN32
+
+namespace hexl {
+
+TestProcessPool::TestProcessPool(Context* context_, unsigned jobs_)
+  : context(context_), jobs(jobs_), watchdog(0), in(-1), out(-1),
+    scheduled(false), hasDeadline(false), infoKnown(false), wavesize(0), wavesPerGroup(0), profile(BRIG_PROFILE_FULL)
+{
+  watchdog = context->Opts()->GetUnsigned("watchdog", 600);
+}
+
+TestProcessPool::~TestProcessPool()
+{
+#ifndef _WIN32
+  // Workers exit when their command pipe is closed.
+  for (Worker& w : workers) {
+    if (w.in >= 0) { close(w.in); }
+    if (w.fd >= 0) { close(w.fd); }
+  }
+  for (Worker& w : workers) {
+    if (w.pid > 0) { waitpid(w.pid, 0, 0); }
+  }
+#endif // _WIN32
+  for (auto& p : pending) { delete p.second; }
+}
+
+bool TestProcessPool::Start()
+{
+#ifdef _WIN32
+  context->Error() << "Test worker processes are not supported on this platform" << std::endl;
+  return false;
+#else
+  // Commands to a worker which has just exited must not kill the parent.
+  signal(SIGPIPE, SIG_IGN);
+  for (unsigned i = 0; i < jobs; ++i) {
+    if (!Spawn()) { return false; }
+  }
+  return true;
+#endif // _WIN32
+}
+
+bool TestProcessPool::Spawn()
+{
+#ifdef _WIN32
+  return false;
+#else
+  // Only the ends used by the worker are inherited by it.
+  int commands[2], records[2];
+  if (pipe2(commands, O_CLOEXEC) != 0) {
+    context->Error() << "Failed to create pipe for test worker: " << strerror(errno) << std::endl;
+    return false;
+  }
+  if (pipe2(records, O_CLOEXEC) != 0) {
+    context->Error() << "Failed to create pipe for test worker: " << strerror(errno) << std::endl;
+    close(commands[0]); close(commands[1]);
+    return false;
+  }
+  std::vector<std::string> args;
+  WorkerArgs(args);
+  std::ostringstream pipes;
+  pipes << commands[0] << "," << records[1];
+  args.push_back("-worker");
+  args.push_back(pipes.str());
+  std::vector<char*> argv;
+  for (std::string& arg : args) { argv.push_back(&arg[0]); }
+  argv.push_back(0);
+  // The parent may run other threads, so the child only calls
+  // async-signal-safe functions before exec.
+  pid_t pid = fork();
+  if (pid < 0) {
+    context->Error() << "Failed to start test worker: " << strerror(errno) << std::endl;
+    close(commands[0]); close(commands[1]);
+    close(records[0]); close(records[1]);
+    return false;
+  }
+  if (pid == 0) {
+    fcntl(commands[0], F_SETFD, 0);
+    fcntl(records[1], F_SETFD, 0);
+    signal(SIGPIPE, SIG_DFL);
+    execv("/proc/self/exe", argv.data());
+    execvp(argv[0], argv.data());
+    _exit(127);
+  }
+  close(commands[0]);
+  close(records[1]);
+  Worker w;
+  w.pid = pid;
+  w.in = commands[1];
+  w.fd = records[0];
+  w.state = WORKER_STARTING;
+  w.killed = false;
+  w.index = 0;
+  workers.push_back(w);
+  return true;
+#endif // _WIN32
+}
+
+bool TestProcessPool::Attach(const std::string& pipes)
+{
+#ifdef _WIN32
+  return false;
+#else
+  std::istringstream s(pipes);
+  char comma;
+  if (!(s >> in >> comma >> out) || comma != ',' || !s.eof()) { return false; }
+  fcntl(in, F_SETFD, FD_CLOEXEC);
+  fcntl(out, F_SETFD, FD_CLOEXEC);
+  return true;
+#endif // _WIN32
+}
+
+static bool WriteAll(int fd, const std::string& data)
+{
+#ifdef _WIN32
+  return false;
+#else
+  const char* p = data.data();
+  size_t left = data.size();
+  while (left > 0) {
+    ssize_t n = write(fd, p, left);
+    if (n < 0) {
+      if (errno == EINTR) { continue; }
+      return false;
+    }
+    p += n; left -= n;
+  }
+  return true;
+#endif // _WIN32
+}
+
+void TestProcessPool::Send(const std::ostringstream& s)
+{
+  std::string data = s.str();
+  uint32_t length = (uint32_t) data.size();
+  data.insert(0, reinterpret_cast<const char*>(&length), sizeof(length));
+  WriteAll(out, data);
+}
+
+bool TestProcessPool::SendCommand(Worker& w, CommandKind kind, uint32_t index)
+{
+  std::ostringstream s;
+  WriteData(s, (uint32_t) kind);
+  WriteData(s, index);
+  return WriteAll(w.in, s.str());
+}
+
+bool TestProcessPool::NextTest(uint32_t& index)
+{
+#ifdef _WIN32
+  return false;
+#else
+  // Commands have fixed size: kind and index.
+  char buffer[2 * sizeof(uint32_t)];
+  size_t got = 0;
+  while (got < sizeof(buffer)) {
+    ssize_t n = read(in, buffer + got, sizeof(buffer) - got);
+    if (n < 0 && errno == EINTR) { continue; }
+    // Parent has gone.
+    if (n <= 0) { return false; }
+    got += n;
+  }
+  std::istringstream s(std::string(buffer, sizeof(buffer)));
+  uint32_t kind;
+  ReadData(s, kind);
+  ReadData(s, index);
+  return kind == COMMAND_RUN;
+#endif // _WIN32
+}
+
+void TestProcessPool::SendStart(uint32_t index, const std::string& name)
+{
+  std::ostringstream s;
+  WriteData(s, (uint32_t) RECORD_START);
+  WriteData(s, index);
+  WriteData(s, name);
+  Send(s);
+}
+
+void TestProcessPool::SendResult(uint32_t index, const std::string& name, const TestResult& result)
+{
+  std::ostringstream s;
+  WriteData(s, (uint32_t) RECORD_RESULT);
+  WriteData(s, index);
+  WriteData(s, name);
+  WriteData(s, result);
+  Send(s);
+}
+
+void TestProcessPool::SendSkipped(uint32_t index)
+{
+  std::ostringstream s;
+  WriteData(s, (uint32_t) RECORD_SKIPPED);
+  WriteData(s, index);
+  Send(s);
+}
+
+void TestProcessPool::SendInfo(const std::string& info, uint32_t wavesize, uint32_t wavesPerGroup, BrigProfile profile)
+{
+  std::ostringstream s;
+  WriteData(s, (uint32_t) RECORD_INFO);
+  WriteData(s, info);
+  WriteData(s, wavesize);
+  WriteData(s, wavesPerGroup);
+  WriteData(s, (uint32_t) profile);
+  Send(s);
+}
+
+void TestProcessPool::SendCounters(const CounterMap& counters)
+{
+  std::ostringstream s;
+  WriteData(s, (uint32_t) RECORD_COUNTERS);
+  WriteData(s, (uint32_t) counters.size());
+  for (auto& c : counters) {
+    WriteData(s, c.first);
+    WriteData(s, (uint32_t) c.second.kind);
+    WriteData(s, c.second.value);
+  }
+  Send(s);
+}
+
+bool TestProcessPool::ReadRecords(Worker& w)
+{
+#ifdef _WIN32
+  return false;
+#else
+  char buffer[65536];
+  ssize_t n = read(w.fd, buffer, sizeof(buffer));
+  if (n < 0 && errno == EINTR) { return true; }
+  if (n <= 0) {
+    WorkerExited(w);
+    return false;
+  }
+  w.buffer.append(buffer, n);
+  size_t pos = 0;
+  while (w.buffer.size() - pos >= sizeof(uint32_t)) {
+    uint32_t length;
+    memcpy(&length, w.buffer.data() + pos, sizeof(length));
+    if (w.buffer.size() - pos - sizeof(length) < length) { break; }
+    std::istringstream s(w.buffer.substr(pos + sizeof(length), length));
+    pos += sizeof(length) + length;
+    uint32_t kind;
+    ReadData(s, kind);
+    Record* r = new Record();
+    r->kind = (RecordKind) kind;
+    r->index = 0;
+    switch (r->kind) {
+    case RECORD_START:
+      ReadData(s, w.index);
+      ReadData(s, w.name);
+      delete r;
+      break;
+    case RECORD_RESULT:
+      ReadData(s, r->index);
+      ReadData(s, r->name);
+      ReadData(s, r->result);
+      if (w.state == WORKER_RUNNING && w.index == r->index) { w.state = WORKER_IDLE; }
+      pending[r->index] = r;
+      break;
+    case RECORD_SKIPPED:
+      ReadData(s, r->index);
+      if (w.state == WORKER_RUNNING && w.index == r->index) { w.state = WORKER_IDLE; }
+      pending[r->index] = r;
+      break;
+    case RECORD_INFO: {
+      std::string info;
+      uint32_t wavesize, wavesPerGroup, profile;
+      ReadData(s, info);
+      ReadData(s, wavesize);
+      ReadData(s, wavesPerGroup);
+      ReadData(s, profile);
+      if (!infoKnown) {
+        this->info = info;
+        this->wavesize = wavesize;
+        this->wavesPerGroup = wavesPerGroup;
+        this->profile = (BrigProfile) profile;
+        infoKnown = true;
+      } else if (wavesize != this->wavesize || wavesPerGroup != this->wavesPerGroup || profile != (uint32_t) this->profile) {
+        // Its tests would not match those enumerated by the parent, the
+        // runner reports them as errors by their names.
+        context->Error() << "Test worker " << w.pid << " has a different agent configuration than the first worker" << std::endl;
+      }
+      if (w.state == WORKER_STARTING) { w.state = WORKER_IDLE; }
+      delete r;
+      break;
+    }
+    case RECORD_COUNTERS: {
+      uint32_t n;
+      ReadData(s, n);
+      for (uint32_t i = 0; i < n; ++i) {
+        std::string name;
+        uint32_t kind;
+        uint64_t value;
+        ReadData(s, name);
+        ReadData(s, kind);
+        ReadData(s, value);
+        AddCounter(counters, name, (CounterKind) kind, value);
+      }
+      delete r;
+      break;
+    }
+    default:
+      assert(false);
+      delete r;
+      break;
+    }
+  }
+  w.buffer.erase(0, pos);
+  return true;
+#endif // _WIN32
+}
+
+void TestProcessPool::WorkerExited(Worker& w)
+{
+#ifndef _WIN32
+  close(w.fd);
+  w.fd = -1;
+  close(w.in);
+  w.in = -1;
+  int status = 0;
+  std::ostringstream reason;
+  if (waitpid(w.pid, &status, 0) == w.pid) {
+    if (w.killed) {
+      reason << "Test worker " << w.pid << " killed after watchdog timeout of " << watchdog << "s";
+    } else if (WIFSIGNALED(status)) {
+      reason << "Test worker " << w.pid << " terminated by signal " << WTERMSIG(status);
+    } else if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+      reason << "Test worker " << w.pid << " exited with code " << WEXITSTATUS(status);
+    }
+  }
+  w.pid = -1;
+  if (!reason.str().empty()) {
+    context->Error() << reason.str() << std::endl;
+  }
+  WorkerState state = w.state;
+  w.state = WORKER_STOPPED;
+  if (state == WORKER_RUNNING) {
+    // The test being run took the worker down: report it and continue in a new worker.
+    if (reason.str().empty()) { reason << "Test worker exited while running the test"; }
+    Record* r = new Record();
+    r->kind = RECORD_RESULT;
+    r->index = w.index;
+    r->name = w.name;
+    r->result = TestResult(ERROR, "START:  " + w.name + "\n" + reason.str() + "\n");
+    r->result.SetTime(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - w.start).count());
+    pending[r->index] = r;
+    // Spawn() may move workers, w is not used after it.
+    Spawn();
+  }
+#endif // _WIN32
+}
+
+int TestProcessPool::WatchdogTimeout()
+{
+  int timeout = -1;
+  if (watchdog == 0) { return timeout; }
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  for (Worker& w : workers) {
+    if (w.fd < 0 || w.state != WORKER_RUNNING || w.killed) { continue; }
+    std::chrono::milliseconds left =
+      std::chrono::duration_cast<std::chrono::milliseconds>(w.start + std::chrono::seconds(watchdog) - now);
+    if (left.count() <= 0) {
+#ifndef _WIN32
+      kill(w.pid, SIGKILL);
+#endif // _WIN32
+      w.killed = true;
+      continue;
+    }
+    if (timeout < 0 || left.count() < timeout) { timeout = (int) left.count(); }
+  }
+  return timeout;
+}
+
+int TestProcessPool::PollTimeout()
+{
+  int timeout = WatchdogTimeout();
+  if (!hasDeadline || queue.empty()) { return timeout; }
+  std::chrono::milliseconds left =
+    std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+  int deadlineTimeout = left.count() > 0 ? (int) left.count() : 0;
+  return timeout < 0 || deadlineTimeout < timeout ? deadlineTimeout : timeout;
+}
+
+void TestProcessPool::Dispatch()
+{
+  if (!scheduled) { return; }
+  if (hasDeadline && !queue.empty() && std::chrono::steady_clock::now() >= deadline) {
+    for (uint32_t index : queue) {
+      Record* r = new Record();
+      r->kind = RECORD_DEADLINE;
+      r->index = index;
+      pending[index] = r;
+    }
+    queue.clear();
+  }
+  for (Worker& w : workers) {
+    if (w.fd < 0 || w.state != WORKER_IDLE) { continue; }
+    if (queue.empty()) {
+      SendCommand(w, COMMAND_STOP);
+      w.state = WORKER_STOPPED;
+      continue;
+    }
+    // A worker which has gone is reported when its pipe is read.
+    if (!SendCommand(w, COMMAND_RUN, queue.front())) { continue; }
+    w.state = WORKER_RUNNING;
+    w.index = queue.front();
+    w.name.clear();
+    w.start = std::chrono::steady_clock::now();
+    queue.pop_front();
+  }
+}
+
+bool TestProcessPool::Poll()
+{
+#ifdef _WIN32
+  return false;
+#else
+  Dispatch();
+  std::vector<pollfd> fds;
+  std::vector<size_t> ws;
+  for (size_t i = 0; i < workers.size(); ++i) {
+    if (workers[i].fd < 0) { continue; }
+    pollfd fd;
+    fd.fd = workers[i].fd;
+    fd.events = POLLIN;
+    fd.revents = 0;
+    fds.push_back(fd);
+    ws.push_back(i);
+  }
+  if (fds.empty()) { return false; }
+  if (poll(fds.data(), fds.size(), PollTimeout()) < 0) {
+    if (errno == EINTR) { return true; }
+    context->Error() << "Failed to wait for test workers: " << strerror(errno) << std::endl;
+    return false;
+  }
+  for (size_t i = 0; i < fds.size(); ++i) {
+    // Spawn() may grow workers, so refer to them by index.
+    if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) { ReadRecords(workers[ws[i]]); }
+  }
+  // Drop workers which have exited and have been waited for.
+  workers.erase(std::remove_if(workers.begin(), workers.end(), [](const Worker& w) { return w.pid < 0; }), workers.end());
+  return true;
+#endif // _WIN32
+}
+
+bool TestProcessPool::WaitInfo()
+{
+  while (!infoKnown) {
+    if (!Poll()) { return false; }
+  }
+  return true;
+}
+
+bool TestProcessPool::RuntimeInfo(std::string& info)
+{
+  if (!WaitInfo()) { return false; }
+  info = this->info;
+  return true;
+}
+
+bool TestProcessPool::AgentConfig(uint32_t& wavesize, uint32_t& wavesPerGroup, BrigProfile& profile)
+{
+  if (!WaitInfo()) { return false; }
+  wavesize = this->wavesize;
+  wavesPerGroup = this->wavesPerGroup;
+  profile = this->profile;
+  return true;
+}
+
+void TestProcessPool::SetDeadline(const std::chrono::steady_clock::time_point& deadline)
+{
+  hasDeadline = true;
+  this->deadline = deadline;
+}
+
+void TestProcessPool::Schedule(const std::vector<uint32_t>& order)
+{
+  queue.insert(queue.end(), order.begin(), order.end());
+  scheduled = true;
+  Dispatch();
+}
+
+TestProcessPool::Record* TestProcessPool::Wait(uint32_t index)
+{
+  while (true) {
+    Dispatch();
+    auto i = pending.find(index);
+    if (i != pending.end()) {
+      Record* r = i->second;
+      pending.erase(i);
+      return r;
+    }
+    if (!Poll()) {
+      context->Error() << "Test workers exited before completing test " << index << std::endl;
+      return 0;
+    }
+  }
+}
+
+void TestProcessPool::Counters(CounterMap& counters)
+{
+  // Idle workers are stopped and send counters just before they exit.
+  queue.clear();
+  scheduled = true;
+  while (Poll()) { }
+  for (auto& c : this->counters) { AddCounter(counters, c.first, c.second.kind, c.second.value); }
+}
+
+/// Walks the test set to the tests with indices handed out by the pool
+/// and runs them. Tests before the next index are skipped without
+/// creating them where the test set supports it. A test with a lower
+/// index than the current one needs a new walk.
+class TestWorkerWalk : public TestSpecIterator {
+private:
+  TestWorkerRunner* runner;
+  TestProcessPool* pool;
+  uint32_t index;
+  uint32_t target;
+  bool more;
+  bool restart;
+
+public:
+  TestWorkerWalk(TestWorkerRunner* runner_, TestProcessPool* pool_, uint32_t target_)
+    : runner(runner_), pool(pool_), index(0), target(target_), more(true), restart(false) { }
+
+  void operator()(const std::string& path, TestSpec* spec) override
+  {
+    if (more && !restart && index == target) {
+      runner->RunIndexedTestSpec(index, path, spec);
+      more = pool->NextTest(target);
+      restart = more && target <= index;
+    } else {
+      delete spec;
+    }
+    ++index;
+  }
+
+  uint64_t Skip(uint64_t count) override
+  {
+    uint64_t skip = count;
+    if (more && !restart) { skip = std::min(count, (uint64_t) (target - index)); }
+    index += (uint32_t) skip;
+    return skip;
+  }
+
+  /// True if there is a test left to run, with index Target().
+  bool More() const { return more; }
+  uint32_t Target() const { return target; }
+  /// True if the walk ended before reaching Target().
+  bool Missed() const { return more && !restart; }
+};
+
+bool TestWorkerRunner::RunTests(TestSet& tests)
+{
+  Init();
+  std::ostringstream info;
+  context->Runtime()->PrintInfo(info);
+  pool->SendInfo(info.str(), context->Runtime()->Wavesize(), context->Runtime()->WavesPerGroup(), context->Runtime()->ModuleProfile());
+  uint32_t target;
+  bool more = pool->NextTest(target);
+  while (more) {
+    TestWorkerWalk walk(this, pool, target);
+    tests.Iterate(walk);
+    more = walk.More();
+    target = walk.Target();
+    if (walk.Missed()) {
+      // Parent enumerated a different test set.
+      pool->SendResult(target, "", TestResult(ERROR, "Test worker did not find the test\n"));
+      more = pool->NextTest(target);
+    }
+  }
+  CounterMap counters;
+  context->Runtime()->Counters(counters);
+  Arena::Counters(counters);
+  pool->SendCounters(counters);
+  return true;
+}
+
+void TestWorkerRunner::RunIndexedTestSpec(uint32_t index, const std::string& path, TestSpec* spec)
+{
+  this->index = index;
+  spec->InitContext(context);
+  if (!spec->IsValid()) {
+    pool->SendSkipped(index);
+    delete spec;
+    return;
+  }
+  pool->SendStart(index, path + "/" + spec->TestName());
+  RunTestSpec(path, spec);
+}
+
+void TestWorkerRunner::ReportResult(const std::string& fullTestName, const TestResult& result)
+{
+  pool->SendResult(index, fullTestName, result);
+}
+
+void TestWorkerRunner::AfterTest(const std::string& path, Test* test, const TestResult& result)
+{
+  result.IncStats(stats);
+  TestResult workerResult(result);
+  workerResult.SetOutput(testOut.Take());
+  pool->SendResult(index, path + "/" + test->TestName(), workerResult);
+}
+
+}
@@ -0,0 +1,198 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef HEXL_TEST_POOL_HPP
+#define HEXL_TEST_POOL_HPP
+
+#include "HexlTestRunner.hpp"
+#include "Brig.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace hexl {
+
+const std::string TEST_POOL_KEY = "hexl.testPool";
+
+/// Pool of worker processes running tests of the same test set.
+///
+/// The parent enumerates the test set once (see
+/// TestRunnerBase::RunPoolTests) and hands out indices of the tests to
+/// run, in the order given to Schedule(), to idle workers over a command
+/// pipe per worker. Every worker creates the same test set and walks it
+/// to the test with the given index. Results are streamed back to the
+/// parent over a pipe per worker and are handed out by Wait() strictly
+/// in test index order.
+///
+/// Workers are new processes executing the runner with WorkerArgs() and
+/// -worker option, so they inherit neither threads nor runtime state of
+/// the parent. Each of them creates its own runtime context. The first
+/// worker reports the wavesize of its agent, with which the parent
+/// creates core configuration to enumerate tests.
+///
+/// A worker that crashes or exceeds the watchdog timeout while running a
+/// test is killed, the test is reported as ERROR and a new worker is
+/// started to continue with the next tests.
+class TestProcessPool {
+public:
+  enum RecordKind {
+    RECORD_RESULT = 0,
+    RECORD_SKIPPED,
+    RECORD_INFO,
+    RECORD_START,
+    RECORD_COUNTERS,
+    /// Test was not handed out before the deadline (parent side only).
+    RECORD_DEADLINE,
+  };
+
+  struct Record {
+    RecordKind kind;
+    uint32_t index;
+    std::string name;
+    TestResult result;
+  };
+
+private:
+  enum CommandKind {
+    COMMAND_RUN = 0,
+    COMMAND_STOP,
+  };
+
+  enum WorkerState {
+    WORKER_STARTING,
+    WORKER_IDLE,
+    WORKER_RUNNING,
+    WORKER_STOPPED,
+  };
+
+  struct Worker {
+    int pid;
+    int in;
+    int fd;
+    std::string buffer;
+    WorkerState state;
+    bool killed;
+    uint32_t index;
+    std::string name;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  Context* context;
+  unsigned jobs;
+  unsigned watchdog;
+  std::vector<Worker> workers;
+  int in;
+  int out;
+  bool scheduled;
+  std::deque<uint32_t> queue;
+  bool hasDeadline;
+  std::chrono::steady_clock::time_point deadline;
+  std::map<uint32_t, Record*> pending;
+  bool infoKnown;
+  std::string info;
+  uint32_t wavesize;
+  uint32_t wavesPerGroup;
+  BrigProfile profile;
+  CounterMap counters;
+
+  bool Spawn();
+  bool Poll();
+  void Dispatch();
+  bool ReadRecords(Worker& w);
+  void WorkerExited(Worker& w);
+  int WatchdogTimeout();
+  int PollTimeout();
+  bool SendCommand(Worker& w, CommandKind kind, uint32_t index = 0);
+  bool WaitInfo();
+  void Send(const std::ostringstream& s);
+
+public:
+  TestProcessPool(Context* context_, unsigned jobs_);
+  virtual ~TestProcessPool();
+
+  unsigned Jobs() const { return jobs; }
+
+  /// Starts the workers.
+  bool Start();
+
+  /// Command line of a worker process, starting with the program name:
+  /// the runner with options of this run. Start() adds -worker option.
+  virtual void WorkerArgs(std::vector<std::string>& args) = 0;
+
+  // Worker side.
+  /// Connects to the parent with pipes given by -worker option. The
+  /// worker should then create runtime and run the test set with
+  /// TestWorkerRunner.
+  bool Attach(const std::string& pipes);
+  /// Waits for the index of the next test to run. Returns false when
+  /// there are no more tests for this worker.
+  bool NextTest(uint32_t& index);
+  void SendStart(uint32_t index, const std::string& name);
+  void SendResult(uint32_t index, const std::string& name, const TestResult& result);
+  void SendSkipped(uint32_t index);
+  void SendInfo(const std::string& info, uint32_t wavesize, uint32_t wavesPerGroup, BrigProfile profile);
+  void SendCounters(const CounterMap& counters);
+
+  // Parent side.
+  /// Waits for runtime information from the first started worker.
+  bool RuntimeInfo(std::string& info);
+  /// Waits for wavesize, waves per work-group and module profile of the
+  /// agent of the first started worker. The parent enumerates tests with
+  /// them, so that it gets the same tests as the workers.
+  bool AgentConfig(uint32_t& wavesize, uint32_t& wavesPerGroup, BrigProfile& profile);
+  /// Tests not handed out to workers by deadline are not run, Wait()
+  /// returns RECORD_DEADLINE records for them.
+  void SetDeadline(const std::chrono::steady_clock::time_point& deadline);
+  /// Hands out tests with given indices to workers in this order.
+  void Schedule(const std::vector<uint32_t>& order);
+  /// Waits for a record for scheduled test index. Returns 0 when all
+  /// workers are gone.
+  Record* Wait(uint32_t index);
+  /// Stops the workers, waits for them to exit and adds up their
+  /// runtime counters.
+  void Counters(CounterMap& counters);
+};
+
+/// Runs the tests handed out by TestProcessPool in a worker process.
+class TestWorkerRunner : public TestRunnerBase {
+private:
+  TestProcessPool* pool;
+  LogBuffer testOut;
+  uint32_t index;
+
+protected:
+  std::ostream* TestOut() { return &testOut; }
+  virtual void AfterTest(const std::string& path, Test* test, const TestResult& result);
+  virtual void ReportResult(const std::string& fullTestName, const TestResult& result);
+
+public:
+  TestWorkerRunner(Context* context_, TestProcessPool* pool_)
+    : TestRunnerBase(context_), pool(pool_), index(0) { }
+
+  virtual bool RunTests(TestSet& tests);
+  void RunIndexedTestSpec(uint32_t index, const std::string& path, TestSpec* spec);
+};
+
+template <>
+inline void Print<TestProcessPool>(const TestProcessPool& pool, std::ostream& out) { out << "<" << pool.Jobs() << " workers>"; }
+
+}
+
+#endif // HEXL_TEST_POOL_HPP
@@ -15,6 +15,12 @@
 */
 
 #include "HexlTestRunner.hpp"
+#include "HexlTestPool.hpp"
+#include "HexlTestJournal.hpp"
+#include "HexlResultSink.hpp"
+#include "HexlTestHistory.hpp"
+#include "HexlTestBudget.hpp"
+#include "Arena.hpp"
 #include "Stats.hpp"
 #include "HexlTest.hpp"
 #include "HexlResource.hpp"
@@ -22,14 +28,132 @@
 #include <sstream>
 #include "Utils.hpp"
 #include <time.h>
+#include <iomanip>
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 namespace hexl {
 
 TestRunnerBase::TestRunnerBase(Context* context_)
-  : TestRunner(context_), testContext(0)
+  : TestRunner(context_), budget(0), budgetReported(false), testContext(0), journal(0), history(0)
 {
 }
 
+TestRunnerBase::~TestRunnerBase()
+{
+  for (ResultSink* sink : sinks) { delete sink; }
+  delete journal;
+  delete history;
+}
+
+bool TestRunnerBase::OpenJournal()
+{
+  // -resume continues the given journal, -journal starts a new one.
+  std::string resume = context->Opts()->GetString("resume");
+  std::string name = resume.empty() ? context->Opts()->GetString("journal") : resume;
+  if (name.empty()) { return true; }
+  journal = new TestJournal(context);
+  if (!journal->Open(name, !resume.empty())) { return false; }
+  if (journal->Count() > 0) {
+    context->Info() << "Resuming after " << journal->Count() << " tests completed in " << name << std::endl;
+  }
+  return true;
+}
+
+bool TestRunnerBase::OpenHistory()
+{
+  std::string name = context->Opts()->GetString("history");
+  if (name.empty()) { return true; }
+  history = new TestHistory(context);
+  return history->Load(name);
+}
+
+void TestRunnerBase::StartBudget()
+{
+  std::string s = context->Opts()->GetString("budget");
+  if (!s.empty() && !BudgetTestSet::ParseBudget(s, budget)) { budget = 0; }
+  deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(budget);
+}
+
+bool TestRunnerBase::IsBudgetExhausted() const
+{
+  if (budget == 0) { return false; }
+  return std::chrono::steady_clock::now() >= deadline;
+}
+
+bool TestRunnerBase::BudgetExhausted()
+{
+  if (!IsBudgetExhausted()) { return false; }
+  if (!budgetReported) {
+    budgetReported = true;
+    RunnerOut() << "Time budget exhausted, remaining tests are skipped" << std::endl;
+  }
+  return true;
+}
+
+bool TestRunnerBase::OpenSinks()
+{
+  std::string timings = context->Opts()->GetString("timings");
+  if (!timings.empty()) { AddResultSink(new TimingsResultSink(context, timings)); }
+  std::string results = context->Opts()->GetString("jsonresults");
+  if (!results.empty()) { AddResultSink(new JsonResultSink(context, results)); }
+  std::string junit = context->Opts()->GetString("junit");
+  if (!junit.empty()) { AddResultSink(new JUnitResultSink(context, junit)); }
+  for (ResultSink* sink : sinks) {
+    if (!sink->Open()) { return false; }
+  }
+  return true;
+}
+
+void TestRunnerBase::FinishTests()
+{
+  for (ResultSink* sink : sinks) { sink->Close(); }
+  if (history) { history->Save(); }
+}
+
+void TestRunnerBase::TestCompleted(const std::string& fullTestName, const TestResult& result)
+{
+  if (journal) { journal->Append(fullTestName, result); }
+  if (history) { history->Update(fullTestName, result.Time(), result.IsFailed() || result.IsError()); }
+  for (ResultSink* sink : sinks) { sink->TestCompleted(fullTestName, result); }
+}
+
+void TestRunnerBase::TestNotRun(const std::string& fullTestName, const TestResult& result)
+{
+  ReportResult(fullTestName, result);
+  for (ResultSink* sink : sinks) { sink->TestCompleted(fullTestName, result); }
+}
+
+void TestRunnerBase::TestSkipped(const std::string& fullTestName)
+{
+  TestNotRun(fullTestName, TestResult(NA, "Skipped: time budget exhausted\n"));
+}
+
+bool TestRunnerBase::IsCompleted(const std::string& path, TestSpec* spec)
+{
+  TestResult result;
+  return journal && journal->Find(path + "/" + spec->TestName(), result);
+}
+
+bool TestRunnerBase::ResumeTest(const std::string& path, TestSpec* spec)
+{
+  if (!journal || !ResumeTest(path + "/" + spec->TestName())) { return false; }
+  delete spec;
+  return true;
+}
+
+bool TestRunnerBase::ResumeTest(const std::string& fullTestName)
+{
+  TestResult result;
+  if (!journal || !journal->Find(fullTestName, result)) { return false; }
+  ReportResumed(fullTestName, result);
+  TestCompleted(fullTestName, result);
+  return true;
+}
+
 void TestRunnerBase::Init()
 {
 }
@@ -40,21 +164,35 @@ void TestRunnerBase::RunTest(const std::string& path, Test* test)
   Init();
   BeforeTest(path, test);
   TestResult result = ExecuteTest(test);
-  t_end = clock();
-  result.SetTime(t_begin, t_end);
+  result.SetTime(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t_begin).count());
+  PhaseTimes* phases = testContext->Phases();
+  if (phases) { result.SetPhases(*phases); }
+  ValidationStats* validation = testContext->Validation();
+  if (validation) { result.SetValidation(*validation); }
+  LatencyStats* latency = testContext->Latency();
+  if (latency) { result.SetLatency(*latency); }
   AfterTest(path, test, result);
 }
 
 void TestRunnerBase::RunTestSpec(const std::string& path, TestSpec* spec)
 {
   spec->InitContext(context);
-  t_begin = clock();
+  t_begin = std::chrono::steady_clock::now();
   Test *test = spec->Create();
   RunTest(path, test);
   if (test) { delete test; }
   delete spec;
 }
 
+void TestRunnerBase::RunCreatedTest(const std::string& path, TestSpec* spec, Test* test)
+{
+  // Test was created ahead by TestRunnerPipeline, time execution only.
+  t_begin = std::chrono::steady_clock::now();
+  RunTest(path, test);
+  if (test) { delete test; }
+  delete spec;
+}
+
 void TestRunnerBase::BeforeTest(const std::string& path, Test* test)
 {
   std::string fullTestName = path + "/" + test->TestName();
@@ -64,6 +202,9 @@ void TestRunnerBase::BeforeTest(const std::string& path, Test* test)
   testContext->Put("hexl.log.stream.debug", TestOut());
   testContext->Put("hexl.log.stream.info", TestOut());
   testContext->Put("hexl.log.stream.error", TestOut());
+  if (!testContext->Has("hexl.phases")) { testContext->Move("hexl.phases", new PhaseTimes()); }
+  testContext->Move("hexl.validation", new ValidationStats());
+  testContext->Move("hexl.latency", new LatencyStats());
   testContext->Info() << "START:  " << fullTestName << std::endl;
   if (testContext->IsVerbose("description")) {
     testContext->Info() << "Test description:" << std::endl;
@@ -88,6 +229,7 @@ void TestRunnerBase::AfterTest(const std::string& path, Test* test, const TestRe
 {
   result.IncStats(stats);
   std::string fullTestName = path + "/" + test->TestName();
+  TestCompleted(fullTestName, result);
   test->GetContext()->Info() <<
     result.StatusString() << ": " <<
     fullTestName << std::endl;
@@ -103,43 +245,348 @@ public:
 
   void operator()(const std::string& path, TestSpec* spec) override
   {
+    if (runner->ResumeTest(path, spec)) { return; }
     spec->InitContext(runner->GetContext());
-    if (spec->IsValid()) {
+    if (!spec->IsValid()) {
+      delete spec;
+    } else if (runner->BudgetExhausted()) {
+      runner->TestSkipped(path + "/" + spec->TestName());
+      delete spec;
+    } else {
       runner->RunTestSpec(path, spec);
+    }
+  }
+};
+
+/// Creates tests for up to lookAhead upcoming specs on worker threads while
+/// the current test executes. Tests are executed and reported in iteration order.
+class TestRunnerPipeline : public TestSpecIterator {
+private:
+  struct PreparedTest {
+    std::string path;
+    TestSpec* spec;
+    Test* test;
+    bool taken;
+    bool ready;
+
+    PreparedTest(const std::string& path_, TestSpec* spec_)
+      : path(path_), spec(spec_), test(0), taken(false), ready(false) { }
+  };
+
+  TestRunnerBase* runner;
+  unsigned lookAhead;
+  std::deque<PreparedTest*> queue;
+  std::mutex mutex;
+  std::condition_variable workAvailable;
+  std::condition_variable testReady;
+  std::vector<std::thread> workers;
+  bool finished;
+
+  void Worker();
+  void RunFront();
+
+public:
+  TestRunnerPipeline(TestRunnerBase* runner_, unsigned lookAhead_);
+  ~TestRunnerPipeline() { Finish(); }
+
+  void operator()(const std::string& path, TestSpec* spec) override;
+  void Finish();
+};
+
+TestRunnerPipeline::TestRunnerPipeline(TestRunnerBase* runner_, unsigned lookAhead_)
+  : runner(runner_), lookAhead(lookAhead_), finished(false)
+{
+  assert(lookAhead > 0);
+  for (unsigned i = 0; i < lookAhead; ++i) {
+    workers.push_back(std::thread(&TestRunnerPipeline::Worker, this));
+  }
+}
+
+void TestRunnerPipeline::Worker()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    PreparedTest* next = 0;
+    for (PreparedTest* p : queue) {
+      if (!p->taken) { next = p; break; }
+    }
+    if (!next) {
+      if (finished) { return; }
+      workAvailable.wait(lock);
+      continue;
+    }
+    next->taken = true;
+    lock.unlock();
+    Test* test = next->spec->Create();
+    lock.lock();
+    next->test = test;
+    next->ready = true;
+    testReady.notify_all();
+  }
+}
+
+void TestRunnerPipeline::RunFront()
+{
+  PreparedTest* p;
+  bool createHere = false;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    assert(!queue.empty());
+    p = queue.front();
+    queue.pop_front();
+    if (!p->taken) {
+      // All workers are busy with later specs, do not wait for them.
+      p->taken = true;
+      createHere = true;
     } else {
-      delete spec;
+      testReady.wait(lock, [p] { return p->ready; });
     }
   }
+  if (createHere) { p->test = p->spec->Create(); }
+  runner->RunCreatedTest(p->path, p->spec, p->test);
+  delete p;
+}
+
+void TestRunnerPipeline::operator()(const std::string& path, TestSpec* spec)
+{
+  if (runner->IsCompleted(path, spec)) {
+    // Keep reporting order: run prepared tests first.
+    while (!queue.empty()) { RunFront(); }
+    runner->ResumeTest(path, spec);
+    return;
+  }
+  spec->InitContext(runner->GetContext());
+  if (!spec->IsValid()) { delete spec; return; }
+  if (runner->BudgetExhausted()) {
+    while (!queue.empty()) { RunFront(); }
+    runner->TestSkipped(path + "/" + spec->TestName());
+    delete spec;
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.push_back(new PreparedTest(path, spec));
+  }
+  workAvailable.notify_one();
+  while (queue.size() > lookAhead) { RunFront(); }
+}
+
+void TestRunnerPipeline::Finish()
+{
+  while (!queue.empty()) { RunFront(); }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (finished) { return; }
+    finished = true;
+  }
+  workAvailable.notify_all();
+  for (std::thread& t : workers) { t.join(); }
+  workers.clear();
+}
+
+/// Enumerates tests of a run with test workers once, in the parent.
+/// Collects tests completed in the journal and valid tests to be run by
+/// workers, in index order.
+class TestPoolCollector : public TestSpecIterator {
+public:
+  struct PoolTest {
+    uint32_t index;
+    std::string name;
+    bool completed;
+  };
+
+private:
+  TestRunnerBase* runner;
+  uint32_t index;
+
+public:
+  std::vector<PoolTest> tests;
+
+  explicit TestPoolCollector(TestRunnerBase* runner_)
+    : runner(runner_), index(0) { }
+
+  void operator()(const std::string& path, TestSpec* spec) override
+  {
+    PoolTest t;
+    t.index = index++;
+    t.completed = runner->IsCompleted(path, spec);
+    if (!t.completed) {
+      spec->InitContext(runner->GetContext());
+      if (!spec->IsValid()) { delete spec; return; }
+    }
+    t.name = path + "/" + spec->TestName();
+    tests.push_back(t);
+    delete spec;
+  }
 };
 
+bool TestRunnerBase::RunPoolTests(TestSet& tests)
+{
+  TestProcessPool* pool = context->Get<TestProcessPool>(TEST_POOL_KEY);
+  TestPoolCollector collector(this);
+  tests.Iterate(collector);
+  std::vector<TestPoolCollector::PoolTest>& poolTests = collector.tests;
+  if (budget != 0 && history && history->Count() > 0) {
+    // Workers share the budget, select tests for all of them here.
+    std::vector<BudgetCandidate> candidates;
+    std::vector<size_t> candidateTests;
+    std::map<std::string, unsigned> paths;
+    for (size_t i = 0; i < poolTests.size(); ++i) {
+      const TestPoolCollector::PoolTest& t = poolTests[i];
+      if (t.completed) { continue; }
+      BudgetCandidate c;
+      c.known = history->Find(t.name, c.time, c.failed);
+      if (!c.known) { c.time = 0; c.failed = false; }
+      std::string path = t.name.substr(0, t.name.rfind('/'));
+      c.path = paths.insert(std::make_pair(path, (unsigned) paths.size())).first->second;
+      c.selected = false;
+      candidates.push_back(c);
+      candidateTests.push_back(i);
+    }
+    if (SelectWithinBudget(context, candidates, (unsigned) paths.size(), budget * pool->Jobs())) {
+      std::vector<bool> drop(poolTests.size(), false);
+      for (size_t j = 0; j < candidates.size(); ++j) {
+        if (!candidates[j].selected) { drop[candidateTests[j]] = true; }
+      }
+      size_t k = 0;
+      for (size_t i = 0; i < poolTests.size(); ++i) {
+        if (!drop[i]) { poolTests[k++] = poolTests[i]; }
+      }
+      poolTests.resize(k);
+    }
+  }
+  // With several workers, tests which took longest in previous runs are
+  // started first, then tests of unknown duration in index order.
+  // Results are still reported in index order.
+  std::vector<std::pair<uint64_t, uint32_t>> known;
+  std::vector<uint32_t> order;
+  for (const TestPoolCollector::PoolTest& t : poolTests) {
+    if (t.completed) { continue; }
+    uint64_t time;
+    if (history && pool->Jobs() > 1 && history->Find(t.name, time)) {
+      known.push_back(std::make_pair(time, t.index));
+    } else {
+      order.push_back(t.index);
+    }
+  }
+  std::stable_sort(known.begin(), known.end(),
+    [](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b) { return a.first > b.first; });
+  std::vector<uint32_t> lpt;
+  for (const std::pair<uint64_t, uint32_t>& k : known) { lpt.push_back(k.second); }
+  order.insert(order.begin(), lpt.begin(), lpt.end());
+  if (budget != 0) { pool->SetDeadline(deadline); }
+  pool->Schedule(order);
+  bool poolAlive = true;
+  for (const TestPoolCollector::PoolTest& t : poolTests) {
+    if (t.completed) {
+      ResumeTest(t.name);
+      continue;
+    }
+    // Once workers are gone, remaining tests are still reported, so that
+    // logs and summaries list every test.
+    TestProcessPool::Record* r = poolAlive ? pool->Wait(t.index) : 0;
+    if (!r) {
+      poolAlive = false;
+      TestNotRun(t.name, TestResult(ERROR, "Test workers exited before running the test\n"));
+      continue;
+    }
+    if (r->kind == TestProcessPool::RECORD_DEADLINE) {
+      // The pool hands out no more tests, only report it.
+      BudgetExhausted();
+      TestSkipped(t.name);
+    } else if (r->kind == TestProcessPool::RECORD_SKIPPED) {
+      TestNotRun(t.name, TestResult(ERROR, "Test worker found the test not valid, its test set differs from that of the parent\n"));
+    } else if (!r->name.empty() && r->name != t.name) {
+      TestNotRun(t.name, TestResult(ERROR, "Test worker ran " + r->name + " instead, its test set differs from that of the parent\n"));
+    } else {
+      ReportResult(t.name, r->result);
+      TestCompleted(t.name, r->result);
+    }
+    delete r;
+  }
+  return poolAlive;
+}
+
+void TestRunnerBase::RuntimeCounters(CounterMap& counters)
+{
+  if (context->Has(TEST_POOL_KEY)) {
+    context->Get<TestProcessPool>(TEST_POOL_KEY)->Counters(counters);
+  } else {
+    if (context->Has("hexl.runtime")) { context->Runtime()->Counters(counters); }
+    Arena::Counters(counters);
+  }
+}
+
 bool TestRunnerBase::RunTests(TestSet& tests)
 {
   Init();
+  StartBudget();
+  if (!OpenJournal()) { return false; }
+  if (!OpenHistory()) { return false; }
+  if (!OpenSinks()) { return false; }
   if (!BeforeTestSet(tests)) { return false; }
-  TestRunnerExecute exec(this);
-  tests.Iterate(exec);
+  if (context->Has(TEST_POOL_KEY)) {
+    RunPoolTests(tests);
+    FinishTests();
+    return AfterTestSet(tests);
+  }
+  unsigned lookAhead = context->Opts()->GetUnsigned("lookahead", 0);
+  if (lookAhead > 0) {
+    TestRunnerPipeline pipeline(this, lookAhead);
+    tests.Iterate(pipeline);
+    pipeline.Finish();
+  } else {
+    TestRunnerExecute exec(this);
+    tests.Iterate(exec);
+  }
+  FinishTests();
   if (!AfterTestSet(tests)) { return false; }
   return true;
 }
 
+std::ostream& TestRunnerBase::RunnerOut()
+{
+  std::ostream* out = context->LogStream(LOG_INFO);
+  return out ? *out : std::cout;
+}
+
 TestResult TestRunnerBase::ExecuteTest(Test* test)
 {
   test->Run();
   return test->Result();
 }
 
+void TestRunnerBase::ReportResult(const std::string& fullTestName, const TestResult& result)
+{
+  result.IncStats(stats);
+  *TestOut() << result.Output() <<
+    result.StatusString() << ": " <<
+    fullTestName << std::endl;
+}
+
+void TestRunnerBase::ReportResumed(const std::string& fullTestName, const TestResult& result)
+{
+  ReportResult(fullTestName, result);
+}
+
 bool SimpleTestRunner::AfterTestSet(TestSet& testSet)
 {
-  std::cout << "Testrun statistics:" << std::endl;
-  IndentStream indent(std::cout);
-  stats.PrintTestSet(std::cout);
+  RunnerOut() << "Testrun statistics:" << std::endl;
+  IndentStream indent(RunnerOut());
+  stats.PrintTestSet(RunnerOut());
   return true;
 }
 
 void SimpleTestRunner::AfterTest(const std::string& path, Test* test, const TestResult& result)
 {
   TestRunnerBase::AfterTest(path, test, result);
-  std::cout << std::endl;
+  RunnerOut() << std::endl;
+}
+
+void SimpleTestRunner::ReportResult(const std::string& fullTestName, const TestResult& result)
+{
+  TestRunnerBase::ReportResult(fullTestName, result);
+  RunnerOut() << std::endl;
 }
 
 HTestRunner::HTestRunner(Context* context_)
@@ -152,8 +599,12 @@ void HTestRunner::BeforeTest(const std::string& path, Test* test)
 {
   TestRunnerBase::BeforeTest(path, test);
   testOut.clear();
-  std::string fullName = path + "/" + test->TestName();
-  std::string cpath = ExtractTestPath(fullName, testLogLevel);
+  BeginPath(path + "/" + test->TestName());
+}
+
+void HTestRunner::BeginPath(const std::string& fullTestName)
+{
+  std::string cpath = ExtractTestPath(fullTestName, testLogLevel);
   if (cpath != pathPrev) {
     if (!pathPrev.empty()) {
       RunnerLog() << "  ";
@@ -180,6 +631,9 @@ bool HTestRunner::BeforeTestSet(TestSet& testSet)
     context->Error() << "Failed to open test log " << testLogName << std::endl;
     return false;
   }
+  if (context->LogWriter()) {
+    testLogStream.reset(new AsyncLogStream(context->LogWriter(), &testLog));
+  }
   std::string testSummaryName = context->Opts()->GetString("testsummary", "test_summary.log");
   testSummary.open(testSummaryName.c_str(), std::ofstream::out);
   if (!testSummary.is_open()) {
@@ -190,9 +644,18 @@ bool HTestRunner::BeforeTestSet(TestSet& testSet)
   SummaryLog() << "UTC Start Date & Time: " << asctime(time_begin_UTC) << std::endl;
   if (context->Opts()->GetBoolean("dsign")) {
      SummaryLog() << "Digital Signature: " << "NNNNNNNNNNNNN" << std::endl << std::endl;
-     testLog << "Digital Signature: " << "NNNNNNNNNNNNN" << std::endl << std::endl;
+     TestLog() << "Digital Signature: " << "NNNNNNNNNNNNN" << std::endl << std::endl;
+  }
+  if (context->Has(TEST_POOL_KEY)) {
+    std::string info;
+    if (!context->Get<TestProcessPool>(TEST_POOL_KEY)->RuntimeInfo(info)) {
+      context->Error() << "Failed to start test workers" << std::endl;
+      return false;
+    }
+    SummaryLog() << info;
+  } else {
+    context->Runtime()->PrintInfo(SummaryLog());
   }
-  context->Runtime()->PrintInfo(SummaryLog());
   SummaryLog() << std::endl << std::endl;
   return true;
 }
@@ -214,31 +677,86 @@ bool HTestRunner::AfterTestSet(TestSet& testSet)
   SummaryLog() << std::endl << "Testrun" << std::endl << "  ";
   Stats().TestSet().PrintShort(RunnerLog()); RunnerLog() << std::endl;
   Stats().TestSet().PrintShort(SummaryLog()); SummaryLog() << std::endl;
+  CounterMap counters;
+  RuntimeCounters(counters);
+  if (!counters.empty()) {
+    RunnerLog() << std::endl << "Runtime counters" << std::endl;
+    SummaryLog() << std::endl << "Runtime counters" << std::endl;
+    for (auto& c : counters) {
+      RunnerLog() << "  " << c.first << ": " << c.second.value << std::endl;
+      SummaryLog() << "  " << c.first << ": " << c.second.value << std::endl;
+    }
+  }
+  if (!Stats().Phases().IsEmpty()) {
+    TestLog() << std::endl << "Phase times" << std::endl << "  ";
+    Stats().Phases().Print(TestLog()); TestLog() << std::endl;
+  }
   RunnerLog()  << std::endl << "UTC Finish Date & Time: " << asctime(time_end_UTC) << std::endl;
   SummaryLog() << std::endl << "UTC Finish Date & Time: " << asctime(time_end_UTC) << std::endl;
   if (context->Opts()->GetBoolean("dsign")) {
      SummaryLog() << "Digital Signature: " << "NNNNNNNNNNNNN" << std::endl;
-     testLog << "Digital Signature: " << "NNNNNNNNNNNNN" << std::endl;
+     TestLog() << "Digital Signature: " << "NNNNNNNNNNNNN" << std::endl;
+  }
+  if (testLogStream) {
+    testLogStream.reset();
+    context->LogWriter()->Flush();
   }
   testLog.close();
   testSummary.close();
   return true;
 }
 
-void HTestRunner::AfterTest(const std::string& path, Test* test, const TestResult& result)
+void HTestRunner::WriteTestLog(std::string&& text)
+{
+  if (testLogStream) {
+    testLogStream->Write(std::move(text));
+  } else {
+    testLog << text;
+  }
+}
+
+void HTestRunner::LogTest(const std::string& fullTestName, const TestResult& result, std::string output)
 {
   if (!result.IsPassed() || context->IsVerbose("testlog", false)) {
-    testLog << testOut.str();
+    WriteTestLog(std::move(output));
   }
-  std::string fullTestName = path + "/" + test->TestName();
-  testLog <<
+  TestLog() <<
     result.StatusString() << ": " <<
     fullTestName << " " << std::setprecision(2) <<
-    result.ExecutionTime() << "s" << std::endl;
-  testLog << std::endl;
+    result.ExecutionTime() << "s [" << TestHashString(TestNameHash(fullTestName)) << "]" << std::endl;
+  if (!result.Phases().IsEmpty()) {
+    TestLog() << "  ";
+    result.Phases().Print(TestLog());
+    TestLog() << std::endl;
+  }
+  if (!result.Latency().IsEmpty()) {
+    TestLog() << "  ";
+    result.Latency().Print(TestLog());
+    TestLog() << std::endl;
+  }
+  TestLog() << std::endl;
   result.IncStats(pathStats);
+}
+
+void HTestRunner::AfterTest(const std::string& path, Test* test, const TestResult& result)
+{
+  LogTest(path + "/" + test->TestName(), result, testOut.Take());
   TestRunnerBase::AfterTest(path, test, result);
-  testOut.str(std::string());
+  testOut.Clear();
+}
+
+void HTestRunner::ReportResult(const std::string& fullTestName, const TestResult& result)
+{
+  BeginPath(fullTestName);
+  LogTest(fullTestName, result, result.Output());
+  result.IncStats(stats);
+}
+
+void HTestRunner::ReportResumed(const std::string& fullTestName, const TestResult& result)
+{
+  // Journal keeps status and time only.
+  TestLog() << "RESUMED: " << fullTestName << " (result from journal, output is in the log of the interrupted run)" << std::endl;
+  ReportResult(fullTestName, result);
 }
 
 }
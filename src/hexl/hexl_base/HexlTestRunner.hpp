@@ -18,12 +18,20 @@
 #define HEXL_TEST_RUNNER_HPP
 
 #include "HexlTest.hpp"
+#include "HexlCounters.hpp"
 #include <sstream>
 #include <fstream>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <vector>
 
 namespace hexl {
 
 class Context;
+class TestJournal;
+class ResultSink;
+class TestHistory;
 
 class TestRunner {
 protected:
@@ -41,26 +49,71 @@ public:
 
 class TestRunnerBase : public TestRunner {
 private:
-  clock_t t_begin, t_end;
+  std::chrono::steady_clock::time_point t_begin;
+  std::chrono::steady_clock::time_point deadline;
+  uint64_t budget;
+  bool budgetReported;
+  std::vector<ResultSink*> sinks;
+
+  bool OpenSinks();
+  void FinishTests();
 
 protected:
   Context* testContext;
   AllStats stats;
+  TestJournal* journal;
+  TestHistory* history;
 
   virtual void Init();
+  bool OpenJournal();
+  bool OpenHistory();
+  /// Starts time budget given by -budget option. The deadline is
+  /// computed once, in the parent process with test workers.
+  void StartBudget();
+  /// Called once per completed test in the parent process, including
+  /// tests run by workers and tests resumed from the journal.
+  void TestCompleted(const std::string& fullTestName, const TestResult& result);
+  /// Reports result of test which was not run, e.g. because test workers
+  /// are gone. It is not recorded in the journal or history.
+  void TestNotRun(const std::string& fullTestName, const TestResult& result);
   virtual bool BeforeTestSet(TestSet& testSet) { return true; }
   virtual bool AfterTestSet(TestSet& testSet) { return true; }
   virtual void BeforeTest(const std::string& path, Test* test);
   virtual void AfterTest(const std::string& path, Test* test, const TestResult& result);
-  virtual std::ostream* TestOut() { return &std::cout; }
+  /// Runner output: info stream of runner context if it is set, otherwise std::cout.
+  std::ostream& RunnerOut();
+  virtual std::ostream* TestOut() { return &RunnerOut(); }
   virtual TestResult ExecuteTest(Test* test);
+  virtual void ReportResult(const std::string& fullTestName, const TestResult& result);
+  /// Reports test completed in an earlier run from its journal record.
+  virtual void ReportResumed(const std::string& fullTestName, const TestResult& result);
+  bool RunPoolTests(TestSet& tests);
+  /// Runtime and arena counters of this process or, with test workers,
+  /// combined over all workers.
+  void RuntimeCounters(CounterMap& counters);
   const AllStats& Stats() const { return stats; }
   AllStats& Stats() { return stats; }
 
 public:
   TestRunnerBase(Context* context_);
+  virtual ~TestRunnerBase();
   virtual void RunTest(const std::string& path, Test* test);
+  bool IsCompleted(const std::string& path, TestSpec* spec);
+  /// True if time budget is set and exhausted, so that remaining tests
+  /// are skipped. BudgetExhausted() also reports it once.
+  bool IsBudgetExhausted() const;
+  bool BudgetExhausted();
+  /// Reports test not run because time budget is exhausted. It is not
+  /// recorded in the journal or history, so that -resume runs it.
+  void TestSkipped(const std::string& fullTestName);
+  /// Reports test completed in the journal without initializing or
+  /// creating it. Returns false if the test is to be run.
+  bool ResumeTest(const std::string& path, TestSpec* spec);
+  bool ResumeTest(const std::string& fullTestName);
+  /// Adds a sink receiving every completed test. Runner takes ownership.
+  void AddResultSink(ResultSink* sink) { sinks.push_back(sink); }
   virtual void RunTestSpec(const std::string& path, TestSpec* spec);
+  virtual void RunCreatedTest(const std::string& path, TestSpec* spec, Test* test);
   virtual bool RunTests(TestSet& tests);
 };
 
@@ -68,6 +121,7 @@ class SimpleTestRunner : public TestRunnerBase {
 protected:
   virtual bool AfterTestSet(TestSet& testSet);
   virtual void AfterTest(const std::string& path, Test* test, const TestResult& result);
+  virtual void ReportResult(const std::string& fullTestName, const TestResult& result);
 
 public:
   SimpleTestRunner(Context* context_)
@@ -77,20 +131,28 @@ public:
 class HTestRunner : public TestRunnerBase {
 private:
   std::string pathPrev;
-  std::ostringstream testOut;
+  LogBuffer testOut;
   std::ofstream testLog;
+  std::unique_ptr<AsyncLogStream> testLogStream;
   std::ofstream testSummary;
   AllStats pathStats;
   unsigned testLogLevel;
 
+  void BeginPath(const std::string& fullTestName);
+  void LogTest(const std::string& fullTestName, const TestResult& result, std::string output);
+  std::ostream& TestLog() { if (testLogStream) { return *testLogStream; } return testLog; }
+  void WriteTestLog(std::string&& text);
+
 protected:
-  std::ostream& RunnerLog() { return std::cout; }
+  std::ostream& RunnerLog() { return RunnerOut(); }
   std::ofstream& SummaryLog() { return testSummary; }
   std::ostream* TestOut() { return &testOut; }
   virtual bool BeforeTestSet(TestSet& testSet);
   virtual bool AfterTestSet(TestSet& testSet);
   virtual void BeforeTest(const std::string& path, Test* test);
   virtual void AfterTest(const std::string& path, Test* test, const TestResult& result);
+  virtual void ReportResult(const std::string& fullTestName, const TestResult& result);
+  virtual void ReportResumed(const std::string& fullTestName, const TestResult& result);
 
 public:
   HTestRunner(Context* context_);
@@ -0,0 +1,94 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "HexlWatchdog.hpp"
+
+namespace hexl {
+
+Watchdog::Deadline::Deadline(Watchdog* watchdog_, Clock::duration timeout)
+  : watchdog(watchdog_), start(Clock::now()), expired(false), watched(false)
+{
+  watchdog->Add(this, start + timeout);
+}
+
+Watchdog::Deadline::~Deadline()
+{
+  watchdog->Remove(this);
+}
+
+double Watchdog::Deadline::Elapsed() const
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+Watchdog::~Watchdog()
+{
+  if (!thread.joinable()) { return; }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  wake.notify_one();
+  thread.join();
+}
+
+void Watchdog::Add(Deadline* deadline, Clock::time_point time)
+{
+  bool first;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!thread.joinable()) { thread = std::thread(&Watchdog::Run, this); }
+    deadline->pos = deadlines.insert(std::make_pair(time, deadline));
+    deadline->watched = true;
+    first = deadline->pos == deadlines.begin();
+  }
+  // Thread only needs to wake up earlier than it planned to.
+  if (first) { wake.notify_one(); }
+}
+
+void Watchdog::Remove(Deadline* deadline)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (deadline->watched) {
+    deadlines.erase(deadline->pos);
+    deadline->watched = false;
+  }
+}
+
+void Watchdog::Run()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!stop) {
+    if (deadlines.empty()) {
+      wake.wait(lock);
+      continue;
+    }
+    Clock::time_point now = Clock::now();
+    while (!deadlines.empty() && deadlines.begin()->first <= now) {
+      Deadline* deadline = deadlines.begin()->second;
+      deadlines.erase(deadlines.begin());
+      deadline->watched = false;
+      deadline->expired.store(true, std::memory_order_release);
+    }
+    if (!deadlines.empty()) {
+      // Copy, entry may be removed while waiting.
+      Clock::time_point next = deadlines.begin()->first;
+      wake.wait_until(lock, next);
+    }
+  }
+}
+
+}
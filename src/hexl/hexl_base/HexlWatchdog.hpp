@@ -0,0 +1,73 @@
+/*
+   Copyright 2014-2015 Heterogeneous System Architecture (HSA) Foundation
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef HEXL_WATCHDOG_HPP
+#define HEXL_WATCHDOG_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace hexl {
+
+/// Single thread tracking deadlines of pending operations on a monotonic
+/// clock. Waiters check Deadline::Expired() between bounded waits instead
+/// of measuring time themselves. The thread is started on first use.
+class Watchdog {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  /// Deadline which is watched from construction to destruction.
+  class Deadline {
+  private:
+    friend class Watchdog;
+    Watchdog* watchdog;
+    Clock::time_point start;
+    std::atomic<bool> expired;
+    bool watched;
+    std::multimap<Clock::time_point, Deadline*>::iterator pos;
+
+  public:
+    Deadline(Watchdog* watchdog_, Clock::duration timeout);
+    ~Deadline();
+
+    bool Expired() const { return expired.load(std::memory_order_acquire); }
+    /// Seconds since construction.
+    double Elapsed() const;
+  };
+
+private:
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::thread thread;
+  bool stop;
+  std::multimap<Clock::time_point, Deadline*> deadlines;
+
+  void Add(Deadline* deadline, Clock::time_point time);
+  void Remove(Deadline* deadline);
+  void Run();
+
+public:
+  Watchdog() : stop(false) { }
+  ~Watchdog();
+};
+
+}
+
+#endif // HEXL_WATCHDOG_HPP
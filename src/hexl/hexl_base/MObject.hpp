@@ -1093,6 +1093,7 @@ struct Serializer<std::vector<T>> {
 RAW_SERIALIZER(uint16_t);
 RAW_SERIALIZER(uint32_t);
 RAW_SERIALIZER(uint64_t);
+RAW_SERIALIZER(double);
 ENUM_SERIALIZER(MObjectType);
 ENUM_SERIALIZER(MObjectMem);
 ENUM_SERIALIZER(ValueType);
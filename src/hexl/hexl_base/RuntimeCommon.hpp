@@ -18,6 +18,8 @@
 #define HEXL_RUNTIME_COMMON_HPP
 
 #include "MObject.hpp"
+#include "HexlCounters.hpp"
+#include <map>
 #include <vector>
 #include <thread>
 #include "Brig.h"
@@ -202,6 +204,9 @@ namespace hexl {
       virtual bool IsLittleEndianness() { return true; };
       virtual BrigProfile ModuleProfile() const;
       bool HasCustomProfile() const;
+      /// Adds values of runtime event counters (e.g. code cache hits)
+      /// to counters, for the run summary.
+      virtual void Counters(CounterMap& counters) const { }
     };
 
     class HostThreads {
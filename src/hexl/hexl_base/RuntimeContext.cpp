@@ -181,21 +181,35 @@ namespace hexl {
   };
 
     class NoneRuntime : public runtime::RuntimeContext {
+    private:
+      uint32_t wavesize;
+      uint32_t wavesPerGroup;
+      BrigProfile profile;
+
     public:
-      explicit NoneRuntime(Context* context)
-        : RuntimeContext(context) { }
+      NoneRuntime(Context* context, uint32_t wavesize_, uint32_t wavesPerGroup_, BrigProfile profile_)
+        : RuntimeContext(context), wavesize(wavesize_), wavesPerGroup(wavesPerGroup_), profile(profile_) { }
 
       bool Init() override { return true; }
       runtime::RuntimeState* NewState(Context* context) override { return new NoneRuntimeState(context); }
       std::string Description() const override { return "No runtime"; }
-      uint32_t Wavesize() override { return 64; }
-      uint32_t WavesPerGroup() override { return 4; }
+      uint32_t Wavesize() override { return wavesize; }
+      uint32_t WavesPerGroup() override { return wavesPerGroup; }
       bool IsLittleEndianness() override { return true; }
+      BrigProfile ModuleProfile() const override { return profile; }
     };
 
     runtime::RuntimeContext* CreateNoneRuntime(Context* context)
     {
-      return new NoneRuntime(context);
+      // Wavesize given by -wavesize, 64 by default, and work-groups of up to 256 work-items.
+      uint32_t wavesize = context->Opts()->GetUnsigned("wavesize", 64);
+      BrigProfile profile = context->Opts()->GetString("profile") == "base" ? BRIG_PROFILE_BASE : BRIG_PROFILE_FULL;
+      return new NoneRuntime(context, wavesize, 256 / wavesize, profile);
+    }
+
+    runtime::RuntimeContext* CreateNoneRuntime(Context* context, uint32_t wavesize, uint32_t wavesPerGroup, BrigProfile profile)
+    {
+      return new NoneRuntime(context, wavesize, wavesPerGroup, profile);
     }
 
   namespace runtime {
@@ -26,6 +26,9 @@ namespace hexl {
   void alignedFree(void *ptr);
 
   runtime::RuntimeContext* CreateNoneRuntime(Context* context);
+  /// None runtime reporting wavesize, waves per work-group and module
+  /// profile of an agent of another process, e.g. of a test worker.
+  runtime::RuntimeContext* CreateNoneRuntime(Context* context, uint32_t wavesize, uint32_t wavesPerGroup, BrigProfile profile);
 
   template <>
   inline void Print(const runtime::RuntimeState& state, std::ostream& out) { state.Print(out); }
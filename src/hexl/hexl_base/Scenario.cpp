@@ -22,6 +22,7 @@
 #include "Utils.hpp"
 #include <thread>
 #include <sstream>
+#include <chrono>
 
 namespace hexl {
 
@@ -34,6 +35,13 @@ namespace scenario {
     commands.push_back(std::unique_ptr<Command>(command));
   }
 
+  void CommandSequence::AddDispatch(Command* command, bool execute)
+  {
+    dispatchCommands.push_back(commands.size());
+    Add(command);
+    if (execute) { dispatchExecuted = true; }
+  }
+
   void CommandSequence::Print(std::ostream& out) const
   {
     for (const std::unique_ptr<Command>& c : commands) {
@@ -51,6 +59,18 @@ namespace scenario {
     return true;
   }
 
+  bool CommandSequence::RepeatDispatch(runtime::RuntimeState* rt, unsigned count, std::vector<uint64_t>& times)
+  {
+    for (unsigned i = 0; i < count; ++i) {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      for (size_t c : dispatchCommands) {
+        if (!commands[c]->Execute(rt)) { return false; }
+      }
+      times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+    return true;
+  }
+
   bool CommandSequence::Finish(runtime::RuntimeState* rt)
   {
     bool result = true;
@@ -557,7 +577,7 @@ class DispatchCreateCommand : public Command {
 
   bool CommandsBuilder::DispatchCreate(const std::string& dispatchId, const std::string& executableId, const std::string& kernelName)
   {
-    commands->Add(new DispatchCreateCommand(dispatchId, executableId, kernelName));
+    commands->AddDispatch(new DispatchCreateCommand(dispatchId, executableId, kernelName));
     return true;
   }
 
@@ -582,7 +602,7 @@ class DispatchCreateCommand : public Command {
 
   bool CommandsBuilder::DispatchArg(const std::string& dispatchId, DispatchArgType argType, const std::string& argKey)
   {
-    commands->Add(new DispatchArgCommand(dispatchId, argType, argKey));
+    commands->AddDispatch(new DispatchArgCommand(dispatchId, argType, argKey));
     return true;
   }
 
@@ -605,7 +625,7 @@ class DispatchCreateCommand : public Command {
 
   bool CommandsBuilder::DispatchExecute(const std::string& dispatchId)
   {
-    commands->Add(new DispatchExecuteCommand(dispatchId));
+    commands->AddDispatch(new DispatchExecuteCommand(dispatchId), true);
     return true;
   }
 
@@ -801,6 +821,18 @@ void ScenarioTest::Run()
   RuntimeContext* runtime = context->Runtime();
   std::unique_ptr<RuntimeState> rt(runtime->NewState(context.get()));
   bool result = scenario->Execute(rt.get());
+  unsigned repeat = context->Opts()->GetUnsigned("repeat", 0);
+  LatencyStats* latency = context->Latency();
+  if (result && repeat > 0 && latency && scenario->CanRepeatDispatch()) {
+    // Results of repeated dispatches are not validated, only timed.
+    std::vector<uint64_t> times;
+    times.reserve(repeat);
+    if (!scenario->RepeatDispatch(rt.get(), repeat, times)) {
+      context->Error() << "Repeated dispatch failed" << std::endl;
+      result = false;
+    }
+    latency->Set(times);
+  }
   if (context->Has(TEST_STATUS_KEY)) {
     TestStatus* status = context->Get<TestStatus>(TEST_STATUS_KEY);
     SetStatus(*status);
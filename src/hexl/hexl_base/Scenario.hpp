@@ -30,12 +30,24 @@ namespace scenario {
   class CommandSequence : public Command {
   private:
     std::vector<std::unique_ptr<Command>> commands;
+    std::vector<size_t> dispatchCommands;
+    bool dispatchExecuted;
 
   public:
+    CommandSequence() : dispatchExecuted(false) { }
+
     void Add(Command* command);
+    /// Adds command creating, setting up or executing (if execute is set)
+    /// a dispatch. Only these commands are repeated by RepeatDispatch.
+    void AddDispatch(Command* command, bool execute = false);
+    bool CanRepeatDispatch() const { return dispatchExecuted; }
     virtual void Print(std::ostream& out) const override;
     bool Execute(runtime::RuntimeState* runtime) override;
     bool Finish(runtime::RuntimeState* runtime) override;
+    /// Executes dispatch commands count more times, adding wall-clock time
+    /// of every repetition in nanoseconds to times. Other commands, such as
+    /// creation and validation of buffers, are neither repeated nor timed.
+    bool RepeatDispatch(runtime::RuntimeState* runtime, unsigned count, std::vector<uint64_t>& times);
   };
 
   class Scenario {
@@ -47,6 +59,9 @@ namespace scenario {
     void AddCommands(CommandSequence* commands);
     bool Execute(runtime::RuntimeState* runtime);
     bool Finish(runtime::RuntimeState* runtime);
+    /// Repeats dispatches of a single threaded scenario, see CommandSequence::RepeatDispatch.
+    bool CanRepeatDispatch() const { return commands.size() == 1 && commands[0]->CanRepeatDispatch(); }
+    bool RepeatDispatch(runtime::RuntimeState* runtime, unsigned count, std::vector<uint64_t>& times) { return commands[0]->RepeatDispatch(runtime, count, times); }
     void Print(std::ostream& out) const;
 
     static Scenario* Get(Context* context) { return context->Get<Scenario>("scenario"); }
@@ -19,6 +19,10 @@
 
 #include <iostream>
 #include <iomanip>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
 
 namespace hexl {
 
@@ -102,6 +106,142 @@ private:
   unsigned operands;
 };
 
+enum TestPhase {
+  PHASE_EMIT = 0,
+  PHASE_FINALIZE,
+  PHASE_LOAD,
+  PHASE_DISPATCH,
+  PHASE_VALIDATE,
+  PHASE_COUNT
+};
+
+inline const char* TestPhaseString(unsigned phase) {
+  switch (phase) {
+  case PHASE_EMIT: return "emit";
+  case PHASE_FINALIZE: return "finalize";
+  case PHASE_LOAD: return "load";
+  case PHASE_DISPATCH: return "dispatch";
+  case PHASE_VALIDATE: return "validate";
+  default: return "<unknown phase>";
+  }
+}
+
+/// Wall-clock time spent in test phases, in nanoseconds.
+class PhaseTimes {
+public:
+  PhaseTimes() { Clear(); }
+
+  uint64_t Get(unsigned phase) const { return times[phase]; }
+  double Seconds(unsigned phase) const { return times[phase] / 1e9; }
+  void Add(unsigned phase, uint64_t time) { times[phase] += time; }
+  void Set(unsigned phase, uint64_t time) { times[phase] = time; }
+  void Clear() { for (unsigned i = 0; i < PHASE_COUNT; ++i) { times[i] = 0; } }
+
+  bool IsEmpty() const {
+    for (unsigned i = 0; i < PHASE_COUNT; ++i) { if (times[i]) { return false; } }
+    return true;
+  }
+
+  void Append(const PhaseTimes& other) {
+    for (unsigned i = 0; i < PHASE_COUNT; ++i) { times[i] += other.times[i]; }
+  }
+
+  void Print(std::ostream& out) const {
+    for (unsigned i = 0; i < PHASE_COUNT; ++i) {
+      if (i > 0) { out << "  "; }
+      out << TestPhaseString(i) << ": " << std::setprecision(2) << Seconds(i) << "s";
+    }
+  }
+
+private:
+  uint64_t times[PHASE_COUNT];
+};
+
+/// Adds time from construction to destruction to a phase, if times are given.
+class PhaseTimer {
+public:
+  PhaseTimer(PhaseTimes* times_, TestPhase phase_)
+    : times(times_), phase(phase_), start(std::chrono::steady_clock::now()) { }
+
+  ~PhaseTimer() {
+    if (times) {
+      times->Add(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+  }
+
+private:
+  PhaseTimes* times;
+  TestPhase phase;
+  std::chrono::steady_clock::time_point start;
+};
+
+/// Memory validation results of a test.
+class ValidationStats {
+public:
+  ValidationStats() { Clear(); }
+
+  unsigned Failures() const { return failures; }
+  unsigned Checks() const { return checks; }
+  double MaxError() const { return maxError; }
+  void Clear() { failures = 0; checks = 0; maxError = 0; }
+
+  void Add(unsigned failures, unsigned checks, double maxError) {
+    this->failures += failures;
+    this->checks += checks;
+    if (maxError > this->maxError) { this->maxError = maxError; }
+  }
+
+private:
+  unsigned failures;
+  unsigned checks;
+  double maxError;
+};
+
+/// Summary of host-observed latencies of repeated dispatches, in nanoseconds.
+class LatencyStats {
+public:
+  LatencyStats() { Clear(); }
+
+  unsigned Count() const { return count; }
+  uint64_t Min() const { return min; }
+  uint64_t Median() const { return median; }
+  uint64_t P90() const { return p90; }
+  uint64_t P99() const { return p99; }
+  bool IsEmpty() const { return count == 0; }
+  void Clear() { count = 0; min = 0; median = 0; p90 = 0; p99 = 0; }
+
+  void Set(unsigned count, uint64_t min, uint64_t median, uint64_t p90, uint64_t p99) {
+    this->count = count; this->min = min; this->median = median; this->p90 = p90; this->p99 = p99;
+  }
+
+  /// Sets summary of samples, which are sorted in place.
+  void Set(std::vector<uint64_t>& samples) {
+    Clear();
+    if (samples.empty()) { return; }
+    std::sort(samples.begin(), samples.end());
+    Set((unsigned) samples.size(), samples[0], Percentile(samples, 50), Percentile(samples, 90), Percentile(samples, 99));
+  }
+
+  void Print(std::ostream& out) const {
+    out << "latency (" << count << " runs): " << std::setprecision(3) <<
+      "min: " << min / 1e3 << "us  median: " << median / 1e3 << "us  " <<
+      "p90: " << p90 / 1e3 << "us  p99: " << p99 / 1e3 << "us";
+  }
+
+private:
+  unsigned count;
+  uint64_t min;
+  uint64_t median;
+  uint64_t p90;
+  uint64_t p99;
+
+  // Nearest-rank percentile of sorted samples.
+  static uint64_t Percentile(const std::vector<uint64_t>& samples, unsigned p) {
+    size_t rank = (samples.size() * p + 99) / 100;
+    return samples[rank > 0 ? rank - 1 : 0];
+  }
+};
+
 class AllStats {
 public:
   void Print(std::ostream& out) const { }
@@ -109,15 +249,18 @@ public:
   const TestSetStats& TestSet() const { return testSetStats; }
   AssemblyStats &Assembly() { return assemblyStats; }
   const AssemblyStats &Assembly() const { return assemblyStats; }
+  PhaseTimes& Phases() { return phaseTimes; }
+  const PhaseTimes& Phases() const { return phaseTimes; }
 
-  void Clear() { testSetStats.Clear(); assemblyStats.Clear(); }
-  void Append(const AllStats& other) { testSetStats.Append(other.testSetStats); assemblyStats.Append(other.assemblyStats); }
+  void Clear() { testSetStats.Clear(); assemblyStats.Clear(); phaseTimes.Clear(); }
+  void Append(const AllStats& other) { testSetStats.Append(other.testSetStats); assemblyStats.Append(other.assemblyStats); phaseTimes.Append(other.phaseTimes); }
   void PrintTest(std::ostream& out) const { assemblyStats.PrintTestInfo(out); }
   void PrintTestSet(std::ostream& out) const { testSetStats.Print(out); assemblyStats.PrintTestInfo(out); }
 
 private:
   TestSetStats testSetStats;
   AssemblyStats assemblyStats;
+  PhaseTimes phaseTimes;
 };
 
 }
@@ -19,6 +19,7 @@
 #include "CoreConfig.hpp"
 #include "Emitter.hpp"
 #include <algorithm>
+#include <mutex>
 #include <sstream>
 
 using namespace HSAIL_ASM;
@@ -30,6 +31,89 @@ namespace emitter {
 
 const Operand BrigEmitter::nullOperand;
 
+namespace {
+
+const size_t THREAD_POOL_SIZE = 8;
+const size_t SHARED_POOL_SIZE = 64;
+
+typedef std::vector<BrigContainer*> ContainerList;
+
+// Shared pool and its mutex are never destroyed, so containers may be
+// released during static destruction, e.g. by a context owned by a
+// static object.
+std::mutex& SharedPoolMutex()
+{
+  static std::mutex* mutex = new std::mutex();
+  return *mutex;
+}
+
+ContainerList& SharedPool()
+{
+  static ContainerList* pool = new ContainerList();
+  return *pool;
+}
+
+// Moves containers to the shared pool while it has room, deletes the rest.
+void ReleaseToShared(ContainerList& containers)
+{
+  std::lock_guard<std::mutex> lock(SharedPoolMutex());
+  for (BrigContainer* c : containers) {
+    if (SharedPool().size() < SHARED_POOL_SIZE) {
+      SharedPool().push_back(c);
+    } else {
+      delete c;
+    }
+  }
+  containers.clear();
+}
+
+// Once the pool of a thread is destroyed on thread exit, containers
+// released on that thread go to the shared pool.
+thread_local bool threadPoolDestroyed = false;
+
+struct ThreadPool {
+  ContainerList containers;
+
+  ~ThreadPool()
+  {
+    threadPoolDestroyed = true;
+    ReleaseToShared(containers);
+  }
+};
+
+thread_local ThreadPool threadPool;
+
+}
+
+BrigContainer* BrigContainerPool::Acquire()
+{
+  if (!threadPoolDestroyed && !threadPool.containers.empty()) {
+    BrigContainer* c = threadPool.containers.back();
+    threadPool.containers.pop_back();
+    return c;
+  }
+  {
+    std::lock_guard<std::mutex> lock(SharedPoolMutex());
+    if (!SharedPool().empty()) {
+      BrigContainer* c = SharedPool().back();
+      SharedPool().pop_back();
+      return c;
+    }
+  }
+  return new BrigContainer();
+}
+
+void BrigContainerPool::Release(BrigContainer* container)
+{
+  container->clear();
+  if (!threadPoolDestroyed && threadPool.containers.size() < THREAD_POOL_SIZE) {
+    threadPool.containers.push_back(container);
+    return;
+  }
+  ContainerList containers(1, container);
+  ReleaseToShared(containers);
+}
+
 BrigType EPointerReg::GetSegmentPointerType(BrigSegment8_t segment, bool large)
 {
   switch (getSegAddrSize(segment, large)) {
@@ -44,7 +128,7 @@ BrigType EPointerReg::GetSegmentPointerType(BrigSegment8_t segment, bool large)
 
 
 BrigEmitter::BrigEmitter()
-  : ap(new Arena()),
+  : ap(ArenaPool::Acquire()),
     coreConfig(0),
     container(nullptr),
     brigantine(nullptr),
@@ -56,7 +140,7 @@ BrigEmitter::BrigEmitter()
 
 BrigEmitter::~BrigEmitter()
 {
-  delete ap;
+  ArenaPool::Release(ap);
 }
 
 void BrigEmitter::DestroyBrigContainer(std::shared_ptr<BrigContainer> container)
@@ -186,7 +270,9 @@ BrigType BrigEmitter::PointerType(BrigSegment8_t asegment) const
 std::shared_ptr<BrigContainer> BrigEmitter::Start()
 {
   assert(coreConfig);
-  container.reset(new HSAIL_ASM::BrigContainer());
+  // Owned by the test context after EModule::EndModule(), which hands it
+  // back to the pool.
+  container.reset(BrigContainerPool::Acquire(), BrigContainerPool::Release);
   brigantine.reset(new HSAIL_ASM::Brigantine(*container));
   brigantine->startProgram();
   return container;
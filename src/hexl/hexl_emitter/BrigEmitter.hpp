@@ -40,10 +40,26 @@ class CoreConfig;
 
 namespace Variables { class Spec; }
 
+/// Containers for emitted modules, reused by later tests instead of
+/// allocating new ones. A released container is cleared but keeps its
+/// section buffers, so emission into it mostly does not allocate.
+///
+/// Containers are kept per thread. Containers released by a thread with
+/// a full pool (e.g. the thread running tests prepared by look-ahead
+/// workers) are shared with other threads.
+///
+/// BrigEmitter::Start() returns a container which goes back to the pool
+/// when its last owner drops it, whether or not the module was completed.
+class BrigContainerPool {
+public:
+  static HSAIL_ASM::BrigContainer* Acquire();
+  static void Release(HSAIL_ASM::BrigContainer* container);
+};
+
 class BrigEmitter {
 private:
   hexl::Arena* ap;
-  CoreConfig* coreConfig;
+  const CoreConfig* coreConfig;
   std::shared_ptr<HSAIL_ASM::BrigContainer> container;
   std::unique_ptr<HSAIL_ASM::Brigantine> brigantine;
   HSAIL_ASM::ExtManager extMgr;
@@ -67,7 +83,7 @@ public:
   BrigEmitter();
   ~BrigEmitter();
 
-  void SetCoreConfig(CoreConfig* coreConfig) { assert(coreConfig && !this->coreConfig); this->coreConfig = coreConfig; }
+  void SetCoreConfig(const CoreConfig* coreConfig) { assert(coreConfig && !this->coreConfig); this->coreConfig = coreConfig; }
   HSAIL_ASM::Brigantine& Brigantine() { assert(brigantine != nullptr); return *brigantine; }
   void DestroyBrigContainer(std::shared_ptr<HSAIL_ASM::BrigContainer> container);
 
@@ -18,6 +18,7 @@
 #include "Emitter.hpp"
 #include "BrigEmitter.hpp"
 #include "RuntimeContext.hpp"
+#include <algorithm>
 
 namespace hexl {
 
@@ -51,11 +52,19 @@ CoreConfig::CoreConfig(
   assert(PlatformEndianness() == ENDIANNESS_LITTLE);
 }
 
+Arena* CoreConfig::Ap() const
+{
+  std::lock_guard<std::mutex> lock(threadApsMutex);
+  std::unique_ptr<Arena>& threadAp = threadAps[std::this_thread::get_id()];
+  if (!threadAp) { threadAp.reset(new Arena()); }
+  return threadAp.get();
+}
+
 CoreConfig* CoreConfig::CreateAndInitialize(Context *context) {
   runtime::RuntimeContext* runtimeContext = context->Runtime();
   BrigProfile8_t profile = runtimeContext->ModuleProfile();
   uint32_t wavesize = runtimeContext->Wavesize();
-  uint8_t wavesPerGroup = static_cast<uint8_t>(runtimeContext->WavesPerGroup());
+  uint8_t wavesPerGroup = static_cast<uint8_t>(std::min<uint32_t>(runtimeContext->WavesPerGroup(), UINT8_MAX));
   return new CoreConfig(
       BRIG_VERSION_HSAIL_MAJOR,
       BRIG_VERSION_HSAIL_MINOR,
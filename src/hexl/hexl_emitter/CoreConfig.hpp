@@ -25,7 +25,12 @@
 #include "EmitterCommon.hpp"
 #include "Image.hpp"
 #include "Utils.hpp"
+#include <map>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include <vector>
 #include <cassert>
 
 #define BRIG_SEGMENT_MAX (BRIG_SEGMENT_ARG + 1)
@@ -34,9 +39,14 @@ namespace hexl {
 
   namespace emitter {
 
+    /// Configuration of tests. Sequences are created by CreateAndInitialize
+    /// and not changed afterwards, so that tests can be iterated and emitted
+    /// on several threads at once.
     class CoreConfig {
     private:
       std::unique_ptr<Arena> ap;
+      mutable std::mutex threadApsMutex;
+      mutable std::map<std::thread::id, std::unique_ptr<Arena>> threadAps;
       BrigVersion32_t majorVersion;
       BrigVersion32_t minorVersion;
       BrigMachineModel8_t model;
@@ -61,7 +71,10 @@ namespace hexl {
       static CoreConfig* Get(hexl::Context *context) { return context->Get<CoreConfig>(CONTEXT_KEY); }
       static CoreConfig* CreateAndInitialize(hexl::Context *context);
 
-      Arena* Ap() { return ap.get(); }
+      /// Arena of the calling thread for sequences and specs allocated while
+      /// iterating tests. Each thread gets one arena per config, kept until
+      /// this config is destroyed.
+      Arena* Ap() const;
       BrigVersion32_t MajorVersion() const { return majorVersion; }
       BrigVersion32_t MinorVersion() const { return minorVersion; }
       BrigMachineModel8_t Model() const { return model; }
@@ -70,7 +83,7 @@ namespace hexl {
       uint8_t WavesPerGroup() const { return wavesPerGroup; }
       bool IsDetectSupported() const { return isDetectSupported; }
       bool IsBreakSupported() const { return isBreakSupported; }
-      EndiannessConfig Endianness() { return endianness; }
+      EndiannessConfig Endianness() const { return endianness; }
 
       bool IsLarge() const {
         switch (model) {
@@ -86,7 +99,7 @@ namespace hexl {
       protected:
         Arena* ap;
       public:
-        ConfigBase(CoreConfig* cc) : ap(cc->Ap()) { }
+        ConfigBase(CoreConfig* cc) : ap(cc->ap.get()) { }
       };
 
       class GridsConfig : public ConfigBase {
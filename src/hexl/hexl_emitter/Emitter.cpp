@@ -107,6 +107,8 @@ namespace Bools {
         a(false);
         a(true);
       }
+      uint64_t Count() const { return 2; }
+      void At(uint64_t index, Action<bool>& a) const { assert(index < 2); a(index != 0); }
     } bools;
     return &bools;
   }
@@ -3166,7 +3168,7 @@ void EModule::StartModule()
 
 void EModule::EndModule()
 {
-  te->InitialContext()->Move(id.str() + ".brig", brigContainer.get());
+  te->InitialContext()->Share(id.str() + ".brig", brigContainer);
   te->Brig()->End();
 }
 
@@ -3672,9 +3674,15 @@ Dispatch TestEmitter::NewDispatch(const std::string& id, const std::string& exec
 
 Test* EmittedTestBase::Create()
 {
-  te->SetCoreConfig(hexl::emitter::CoreConfig::Get(context.get()));
-  Test();
-  return new ScenarioTest(TestName(), te->ReleaseContext());
+  PhaseTimes* phases = new PhaseTimes();
+  {
+    PhaseTimer timer(phases, PHASE_EMIT);
+    te->SetCoreConfig(hexl::emitter::CoreConfig::Get(context.get()));
+    Test();
+  }
+  Context* testContext = te->ReleaseContext();
+  testContext->Move("hexl.phases", phases);
+  return new ScenarioTest(TestName(), testContext);
 }
 
 EmittedTest::EmittedTest(emitter::Location codeLocation_, Grid geometry_)
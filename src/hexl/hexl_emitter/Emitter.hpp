@@ -949,7 +949,8 @@ class CoreConfig;
 class TestEmitter {
 private:
   Context* context;
-  Arena ap;
+  // Declared first: objects in the arena may be used until other members are destroyed.
+  PooledArena ap;
   std::unique_ptr<BrigEmitter> be;
   std::unique_ptr<Context> initialContext;
   std::unique_ptr<hexl::scenario::ScenarioBuilder> scenario;
@@ -961,7 +962,7 @@ public:
   Context* EmitContext() { return context; }
   void SetCoreConfig(CoreConfig* cc);
 
-  Arena* Ap() { return &ap; }
+  Arena* Ap() { return ap.Get(); }
 
   BrigEmitter* Brig() { return be.get(); }
   CoreConfig* CoreCfg() { return coreConfig; }
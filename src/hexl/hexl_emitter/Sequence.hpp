@@ -47,7 +47,7 @@ namespace hexl {
   private:
     class CountAction : public Action<T> {
     private:
-      unsigned count;
+      uint64_t count;
 
     public:
       explicit CountAction()
@@ -55,7 +55,7 @@ namespace hexl {
       void operator()(const T& item) {
         count++;
       }
-      unsigned Count() const { return count; }
+      uint64_t Count() const { return count; }
     };
 
     class HasAction : public Action<T> {
@@ -98,12 +98,17 @@ namespace hexl {
   public:
     virtual void Iterate(Action<T>& a) const = 0;
 
-    unsigned Count() const {
+    virtual uint64_t Count() const {
       CountAction counter;
       Iterate(counter);
       return counter.Count();
     }
 
+    /// Applies action to the item with given index in iteration order.
+    /// Every sequence provides it without iterating over preceding items,
+    /// as tests are enumerated by index into products of sequences.
+    virtual void At(uint64_t index, Action<T>& a) const = 0;
+
     bool Has(const T& value) const {
       HasAction has(value);
       Iterate(has);
@@ -132,6 +137,8 @@ namespace hexl {
   class EmptySequence : public Sequence<T> {
   public:
     void Iterate(Action<T>& a) const { }
+    uint64_t Count() const { return 0; }
+    void At(uint64_t index, Action<T>& a) const { assert(false); }
   };
 
   template<typename T>
@@ -142,6 +149,8 @@ namespace hexl {
   public:
     explicit OneValueSequence(const T& value_) : value(value_) { }
     void Iterate(Action<T>& a) const { a(value); }
+    uint64_t Count() const { return 1; }
+    void At(uint64_t index, Action<T>& a) const { assert(index == 0); a(value); }
   };
 
   template<typename T>
@@ -160,6 +169,9 @@ namespace hexl {
       for (unsigned i = 0; i < length; ++i) 
         a(values[i]);
     }
+
+    uint64_t Count() const { return length; }
+    void At(uint64_t index, Action<T>& a) const { assert(index < length); a(values[index]); }
   };
 
   template<typename T>
@@ -183,6 +195,9 @@ namespace hexl {
     void Iterate(Action<T>& a) const {
       for (size_t i = 0; i < index; ++i) { a(values[i]); }
     }
+
+    uint64_t Count() const { return index; }
+    void At(uint64_t i, Action<T>& a) const { assert(i < index); a(values[i]); }
   };
 
   template <typename T>
@@ -250,6 +265,23 @@ namespace hexl {
     }
   };
 
+  template <typename P1, typename P2>
+  class ForwardIndexedPairAction : public Action<P1> {
+  private:
+    Sequence<P2>* p2s;
+    uint64_t index;
+    Action<Pair<P1, P2>>& p;
+
+  public:
+    ForwardIndexedPairAction(Sequence<P2>* p2s_, uint64_t index_, Action<Pair<P1, P2>>& p_)
+      : p2s(p2s_), index(index_), p(p_) { }
+
+    void operator()(const P1& p1) {
+      ApplyPairAction<P1, P2> action(p1, p);
+      p2s->At(index, action);
+    }
+  };
+
   template <typename P1, typename P2>
   class SequenceProduct2 : public Sequence<Pair<P1, P2>> {
   private:
@@ -264,6 +296,15 @@ namespace hexl {
       ForwardPairAction<P1, P2> p1a(p2s, a);
       p1s->Iterate(p1a);
     }
+
+    uint64_t Count() const { return p1s->Count() * p2s->Count(); }
+
+    // Mixed-radix index: the first sequence changes slowest, as in Iterate.
+    void At(uint64_t index, Action<Pair<P1, P2>>& a) const {
+      uint64_t count2 = p2s->Count();
+      ForwardIndexedPairAction<P1, P2> p1a(p2s, index % count2, a);
+      p1s->At(index / count2, p1a);
+    }
   };
 
   template <typename P1, typename P2, typename P3>
@@ -491,6 +532,13 @@ namespace hexl {
       MapAction ma(ap, a);
       s->Iterate(ma);
     }
+
+    uint64_t Count() const { return s->Count(); }
+
+    void At(uint64_t index, Action<T*>& a) const {
+      MapAction ma(ap, a);
+      s->At(index, ma);
+    }
   };
 
   template<typename T, typename P1, typename P2>
@@ -522,6 +570,13 @@ namespace hexl {
       MapAction ma(ap, a);
       s->Iterate(ma);
     }
+
+    uint64_t Count() const { return s->Count(); }
+
+    void At(uint64_t index, Action<T*>& a) const {
+      MapAction ma(ap, a);
+      s->At(index, ma);
+    }
   };
 
   template<typename T, typename P1, typename P2, typename P3>
@@ -553,6 +608,13 @@ namespace hexl {
       MapAction ma(ap, a);
       s->Iterate(ma);
     }
+
+    uint64_t Count() const { return s->Count(); }
+
+    void At(uint64_t index, Action<T*>& a) const {
+      MapAction ma(ap, a);
+      s->At(index, ma);
+    }
   };
 
   template<typename T, typename P1, typename P2, typename P3, typename P4>
@@ -584,6 +646,13 @@ namespace hexl {
       MapAction ma(ap, a);
       s->Iterate(ma);
     }
+
+    uint64_t Count() const { return s->Count(); }
+
+    void At(uint64_t index, Action<T*>& a) const {
+      MapAction ma(ap, a);
+      s->At(index, ma);
+    }
   };
 
   template<typename T, typename P1, typename P2, typename P3, typename P4, typename P5>
@@ -615,6 +684,13 @@ namespace hexl {
       MapAction ma(ap, a);
       s->Iterate(ma);
     }
+
+    uint64_t Count() const { return s->Count(); }
+
+    void At(uint64_t index, Action<T*>& a) const {
+      MapAction ma(ap, a);
+      s->At(index, ma);
+    }
   };
 
   template <typename T, typename P1>
@@ -683,6 +759,20 @@ namespace hexl {
       SubsequenceAction<T> as(bits, a);
       sequence->Iterate(as);
     }
+
+    uint64_t Count() const {
+      uint64_t count = 0;
+      for (uint32_t b = bits; b; b &= b - 1) { count++; }
+      return count;
+    }
+
+    // Item index of the set bit with given rank.
+    void At(uint64_t index, Action<T>& a) const {
+      for (unsigned i = 0; i < 16; ++i) {
+        if ((bits & (1u << i)) && index-- == 0) { sequence->At(i, a); return; }
+      }
+      assert(false);
+    }
   };
 
   template <typename T>
@@ -690,24 +780,31 @@ namespace hexl {
   private:
     Arena* ap;
     const Sequence<T>* sequence;
-    mutable std::vector<SubsetSequence<T>*, ArenaAllocator<SubsetSequence<T>*>> subsequences;
+    std::vector<SubsetSequence<T>*, ArenaAllocator<SubsetSequence<T>*>> subsequences;
     unsigned count;
 
   public:
+    // Subsets are created here, iteration does not change the sequence.
     explicit SubsetsSequence(Arena* ap_, const Sequence<T>* sequence_)
       : ap(ap_), sequence(sequence_), subsequences(ap_), count(sequence->Count())
     {
       assert(count <= 8); // Let's be reasonable.
+      for (unsigned i = 0; i < (1u << count); ++i) {
+        subsequences.push_back(NEWA SubsetSequence<T>(sequence, i));
+      }
     }
 
     void Iterate(Action<Sequence<T>*>& a) const {
-      for (size_t i = subsequences.size(); i < (uint64_t) (1 << count); ++i) {
-        subsequences.push_back(NEWA SubsetSequence<T>(sequence, (unsigned) i));
-      }
       for (SubsetSequence<T>* subsequence : subsequences) {
         a(subsequence);
       }
     }
+
+    uint64_t Count() const { return 1 << count; }
+
+    void At(uint64_t index, Action<Sequence<T>*>& a) const {
+      a(subsequences[index]);
+    }
   };
 
   template <typename T>
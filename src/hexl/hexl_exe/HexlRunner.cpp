@@ -30,6 +30,7 @@
 #include "HexlAgent.hpp"
 #endif // ENABLE_HEXL_AGENT
 
+#include <chrono>
 #include <fstream>
 #include <iostream>
 
@@ -50,6 +51,7 @@ private:
 
   int ParseOptions();
   TestSet* CreateTestSet(const size_t i = 0);
+  int ParseBench(unsigned count);
 };
 
 HexlRunner::HexlRunner(int argc_, char **argv_)
@@ -93,6 +95,8 @@ int HexlRunner::ParseOptions()
   optReg.RegisterOption("testsummary");
   optReg.RegisterOption("rtlib");
   optReg.RegisterOption("timeout");
+  optReg.RegisterOption("repeat");
+  optReg.RegisterOption("parsebench");
   int n;
   if ((n = hexl::ParseOptions(argc, argv, optReg, options)) != 0) {
     std::cout << "Invalid option: " << argv[n] << std::endl;
@@ -116,6 +120,16 @@ int HexlRunner::ParseOptions()
       return 7;
     }
   }
+  if (options.IsSet("parsebench")) {
+    if (options.GetUnsigned("parsebench", 0) == 0) {
+      std::cout << "Bad -parsebench: '" << options.GetString("parsebench") << "'" << std::endl;
+      return 8;
+    }
+    if (!options.IsSet("testlist") || !options.IsSet("test")) {
+      std::cout << "parsebench requires testlist and test options" << std::endl;
+      return 5;
+    }
+  }
   return 0;
 }
 
@@ -148,6 +162,31 @@ TestSet* HexlRunner::CreateTestSet(const size_t i)
   }
 }
 
+/// Reads every testlist count times and prints parse throughput
+/// (-parsebench). No runtime is created and no test is run.
+int HexlRunner::ParseBench(unsigned count)
+{
+  std::string testType = options.GetString("test");
+  std::string key = options.GetString("key", "");
+  const Options::MultiString* t = options.GetMultiString("testlist"); assert(t);
+  for (const std::string& name : *t) {
+    size_t tests = 0;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < count; ++i) {
+      SimpleTestList testList(name, testFactory.get(), testType, key);
+      if (!testList.ReadFrom(context->RM(), name)) {
+        context->Error() << "Failed to read testlist '" << name << "'" << std::endl;
+        return 5;
+      }
+      tests += testList.TestCount();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << name << ": " << count << " parses, " << tests / count << " tests, " <<
+      seconds / count << "s per parse, " << (seconds > 0 ? tests / seconds : 0) << " tests/s" << std::endl;
+  }
+  return 0;
+}
+
 void HexlRunner::Run()
 {
   int result = 4;
@@ -156,6 +195,11 @@ void HexlRunner::Run()
   context->Put("hexl.stats", new AllStats());
   ResourceManager* rm = new DirectoryResourceManager(options.GetString("testbase", "."), options.GetString("results", "."));
   context->Put("hexl.rm", rm);
+  if (result == 0 && options.IsSet("parsebench")) {
+    result = ParseBench(options.GetUnsigned("parsebench", 1));
+    delete rm;
+    exit(result);
+  }
   runtime::RuntimeContext* runtime = CreateRuntimeContext(context.get());
   if (runtime) {
     std::cout << "Runtime: " << runtime->Description() << std::endl;
@@ -20,17 +20,27 @@
 #include "Scenario.hpp"
 #include "Utils.hpp"
 #include "DllApi.hpp"
+#include "HexlHash.hpp"
 #include <cstring>
 #include <algorithm>
 #include <sstream>
-#include <time.h>
 #include <set>
 #include <bitset>
+#include <fstream>
+#include <iterator>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #if defined(_WIN32) || defined(_WIN64)  // Windows
   #include <intrin.h>
   #pragma intrinsic (_InterlockedExchange16)
 #endif
+#ifndef _WIN32
+#include <unistd.h>
+#endif // _WIN32
 
 using namespace hexl;
 using namespace hexl::runtime;
@@ -71,6 +81,8 @@ const HsaApiTable* HsaApi::InitApiTable() {
 
   GET_FUNCTION(hsa_executable_create);
   GET_FUNCTION(hsa_code_object_destroy);
+  GET_FUNCTION(hsa_code_object_serialize);
+  GET_FUNCTION(hsa_code_object_deserialize);
   GET_FUNCTION(hsa_executable_load_code_object);
   GET_FUNCTION(hsa_executable_symbol_get_info);
   GET_FUNCTION(hsa_executable_get_symbol);
@@ -149,6 +161,25 @@ void HsaQueueErrorCallback(hsa_status_t status, hsa_queue_t *source, void *data)
   runtime->QueueError(status);
 }
 
+template <typename T>
+static void AppendCodeKey(std::string& key, const T& value)
+{
+  key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/// Appends BRIG sections of module to the code cache key.
+static void AppendModuleKey(std::string& key, BrigModule_t module)
+{
+  const char* base = reinterpret_cast<const char*>(module);
+  const uint64_t* offsets = reinterpret_cast<const uint64_t*>(base + module->sectionIndex);
+  AppendCodeKey(key, module->sectionCount);
+  for (uint32_t i = 0; i < module->sectionCount; ++i) {
+    const BrigSectionHeader* section = reinterpret_cast<const BrigSectionHeader*>(base + offsets[i]);
+    AppendCodeKey(key, section->byteCount);
+    key.append(reinterpret_cast<const char*>(section), (size_t) section->byteCount);
+  }
+}
+
   class HsailRuntimeContextState : public runtime::RuntimeState {
   private:
     HsailRuntimeContext* runtime;
@@ -202,6 +233,7 @@ void HsaQueueErrorCallback(hsa_status_t status, hsa_queue_t *source, void *data)
     private:
       HsailRuntimeContextState* rt;
       hsa_ext_program_t program;
+      std::string key;
 
     public:
       HsailProgram(HsailRuntimeContextState* rt_, hsa_ext_program_t program_)
@@ -214,6 +246,8 @@ void HsaQueueErrorCallback(hsa_status_t status, hsa_queue_t *source, void *data)
       }
 
       hsa_ext_program_t Program() { return program; }
+      /// Code cache key of modules added so far and program options.
+      std::string& Key() { return key; }
     };
 
     void ProgramDestroy(hsa_ext_program_t program)
@@ -230,7 +264,11 @@ void HsaQueueErrorCallback(hsa_status_t status, hsa_queue_t *source, void *data)
         Runtime()->Hsa()->hsa_ext_program_create(
           machineModel, Runtime()->ProgramProfile(), HSA_DEFAULT_FLOAT_ROUNDING_MODE_ZERO, "", &program);
       if (status != HSA_STATUS_SUCCESS) { Runtime()->HsaError("hsa_ext_program_create failed", status); return false; }
-      Put(programId, new HsailProgram(this, program));
+      HsailProgram* hprogram = new HsailProgram(this, program);
+      AppendCodeKey(hprogram->Key(), machineModel);
+      AppendCodeKey(hprogram->Key(), Runtime()->ProgramProfile());
+      AppendCodeKey(hprogram->Key(), HSA_DEFAULT_FLOAT_ROUNDING_MODE_ZERO);
+      Put(programId, hprogram);
       return true;
     }
 
@@ -240,49 +278,54 @@ void HsaQueueErrorCallback(hsa_status_t status, hsa_queue_t *source, void *data)
       BrigModule_t module = context->Get<BrigModuleHeader>(moduleId);
       hsa_status_t status = Runtime()->Hsa()->hsa_ext_program_add_module(program->Program(), module);
       if (status != HSA_STATUS_SUCCESS) { Runtime()->HsaError("hsa_ext_add_module failed", status); return false; }
+      AppendModuleKey(program->Key(), module);
       return true;
     }
 
     class HsailCode {
     private:
-      HsailRuntimeContextState* rt;
-      hsa_code_object_t code;
+      CodeObjectCache::Code code;
 
     public:
-      HsailCode(HsailRuntimeContextState* rt_, hsa_code_object_t code_)
-        : rt(rt_), code(code_) { }
-      ~HsailCode()
-      {
-#ifndef _WIN32
-        // Temporarily disable due to crash on Windows.
-        rt->CodeDestroy(code);
-#endif // _WIN32
-      }
+      explicit HsailCode(const CodeObjectCache::Code& code_)
+        : code(code_) { }
 
-      hsa_code_object_t Code() { return code; }
+      hsa_code_object_t Code() { return *code; }
     };
 
-    void CodeDestroy(hsa_code_object_t code)
-    {
-      hsa_status_t status = Runtime()->Hsa()->hsa_code_object_destroy(code);
-      if (status != HSA_STATUS_SUCCESS) { Runtime()->HsaError("hsa_code_object_destroy failed", status); }
-    }
-
-
     virtual bool ProgramFinalize(const std::string& codeId = "code", const std::string& programId = "program") override
     {
+      PhaseTimer timer(context->Phases(), PHASE_FINALIZE);
       HsailProgram* program = context->Get<HsailProgram>(programId);
       hsa_isa_t isa;
       hsa_status_t status = Runtime()->Hsa()->hsa_agent_get_info(Runtime()->Agent(), HSA_AGENT_INFO_ISA, &isa);
       if (status != HSA_STATUS_SUCCESS) { Runtime()->HsaError("hsa_agent_get_info(HSA_AGENT_INFO_ISA) failed", status); return 0; }
-      hsa_ext_control_directives_t cd;
-      memset(&cd, 0, sizeof(cd));
-      hsa_code_object_t codeObject;
-      status = Runtime()->Hsa()->hsa_ext_program_finalize(
-        program->Program(),
-        isa, 0, cd, "", HSA_CODE_OBJECT_TYPE_PROGRAM, &codeObject);
-      if (status != HSA_STATUS_SUCCESS) { Runtime()->HsaError("hsa_ext_finalize_program failed", status); return false; }
-      Put(codeId, new HsailCode(this, codeObject));
+      std::string key = program->Key();
+      AppendCodeKey(key, isa.handle);
+      uint64_t hash = Hash64::Of(key);
+      CodeObjectCache::Code code = Runtime()->CodeCache().Find(hash, key);
+      if (!code) {
+        std::string fileKey;
+        uint64_t fileHash = 0;
+        if (Runtime()->HasCodeDir()) {
+          fileKey = Runtime()->CodeDirKey(program->Key());
+          fileHash = Hash64::Of(fileKey);
+          code = Runtime()->LoadCodeFile(fileHash, fileKey);
+        }
+        if (!code) {
+          hsa_ext_control_directives_t cd;
+          memset(&cd, 0, sizeof(cd));
+          hsa_code_object_t codeObject;
+          status = Runtime()->Hsa()->hsa_ext_program_finalize(
+            program->Program(),
+            isa, 0, cd, "", HSA_CODE_OBJECT_TYPE_PROGRAM, &codeObject);
+          if (status != HSA_STATUS_SUCCESS) { Runtime()->HsaError("hsa_ext_finalize_program failed", status); return false; }
+          code = Runtime()->ShareCode(codeObject);
+          if (Runtime()->HasCodeDir()) { Runtime()->SaveCodeFile(fileHash, fileKey, codeObject); }
+        }
+        Runtime()->CodeCache().Add(hash, key, code);
+      }
+      Put(codeId, new HsailCode(code));
       return true;
     }
 
@@ -321,6 +364,7 @@ void HsaQueueErrorCallback(hsa_status_t status, hsa_queue_t *source, void *data)
 
     virtual bool ExecutableLoadCode(const std::string& executableId = "executable", const std::string& codeId = "code") override
     {
+      PhaseTimer timer(context->Phases(), PHASE_LOAD);
       HsailExecutable* executable = context->Get<HsailExecutable>(executableId);
       HsailCode* code = context->Get<HsailCode>(codeId);
       hsa_status_t status = Runtime()->Hsa()->hsa_executable_load_code_object(executable->Executable(), Runtime()->Agent(), code->Code(), "");
@@ -406,6 +450,7 @@ void HsaQueueErrorCallback(hsa_status_t status, hsa_queue_t *source, void *data)
 
     virtual bool BufferValidate(const std::string& bufferId, const std::string& expectedValuesId, ValueType memoryType, const std::string& method = "") override
     {
+      PhaseTimer timer(context->Phases(), PHASE_VALIDATE);
       HsailBuffer *buf = context->Get<HsailBuffer>(bufferId);
       context->Info() << "Validating buffer " << bufferId << " with expected values " << expectedValuesId << "(method: " << method << ")" << std::endl;
       Values* expectedValues = context->Get<Values>(expectedValuesId);
@@ -670,7 +715,6 @@ class ImageRegionMatcher {
       hsa_executable_symbol_t kernel;
       uint64_t packetId;
       hsa_kernel_dispatch_packet_t* packet;
-      uint64_t timeout;
       size_t kernargOffset;
       void* kernargAddr;
       hsa_signal_t completionSignal;
@@ -776,7 +820,6 @@ class ImageRegionMatcher {
       d->kernel = kernel;
       d->packetId = packetId;
       d->packet = p;
-      d->timeout = TIMEOUT * CLOCKS_PER_SEC;
       d->kernargOffset = 0;
       d->kernargAddr = p->kernarg_address;
       d->completionSignal = p->completion_signal;
@@ -864,6 +907,7 @@ class ImageRegionMatcher {
 
     virtual bool DispatchExecute(const std::string& dispatchId) override
     {
+      PhaseTimer timer(context->Phases(), PHASE_DISPATCH);
       HsailDispatch* d = context->Get<HsailDispatch>(dispatchId);
       assert(d);
 
@@ -879,16 +923,12 @@ class ImageRegionMatcher {
       Runtime()->Hsa()->hsa_signal_store_release(queue->doorbell_signal, d->packetId);
 
       // Wait for kernel completion.
-      hsa_signal_value_t result;
-      clock_t beg = clock();
-      do {
-        result = Runtime()->Hsa()->hsa_signal_wait_acquire(d->completionSignal, HSA_SIGNAL_CONDITION_EQ, 0, d->timeout, HSA_WAIT_STATE_ACTIVE);
-        clock_t clocks = clock() - beg;
-        if (clocks > (clock_t) d->timeout && result != 0) {
-          context->Error() << "Kernel execution timed out, elapsed time: " << (long) clocks << " clocks (clocks per second " << (long) CLOCKS_PER_SEC << ")" << std::endl;
-          return false;
-        }
-      } while (result!= 0 && !runtime->IsQueueError());
+      Watchdog::Deadline deadline(Runtime()->SignalWatchdog(), std::chrono::seconds(TIMEOUT));
+      hsa_signal_value_t result = Runtime()->SignalWait(d->completionSignal, 0, deadline, true);
+      if (result != 0 && !runtime->IsQueueError()) {
+        context->Error() << "Kernel execution timed out, elapsed time: " << deadline.Elapsed() << " s" << std::endl;
+        return false;
+      }
       return !runtime->IsQueueError();
     }
 
@@ -935,21 +975,14 @@ class ImageRegionMatcher {
 
     virtual bool SignalWait(const std::string& signalId, uint64_t expectedValue = 1) override
     {
-      uint64_t timeout = TIMEOUT * CLOCKS_PER_SEC;
       HsailSignal* signal = context->Get<HsailSignal>(signalId);
-      hsa_signal_value_t acquiredValue;
+      Watchdog::Deadline deadline(Runtime()->SignalWatchdog(), std::chrono::seconds(TIMEOUT));
+      hsa_signal_value_t acquiredValue = Runtime()->SignalWait(signal->Signal(), expectedValue, deadline, false);
       bool result = true;
-      clock_t beg = clock();
-      do {
-        acquiredValue = Runtime()->Hsa()->hsa_signal_wait_acquire(signal->Signal(), HSA_SIGNAL_CONDITION_EQ, expectedValue, timeout, HSA_WAIT_STATE_ACTIVE);
-        clock_t clocks = clock() - beg;
-        if (clocks > (clock_t) timeout && acquiredValue != (hsa_signal_value_t) expectedValue) {
-          context->Info() << "Signal '" << signalId << "' wait timed out, elapsed time: " <<
-            (uint64_t)clocks << " clocks (clocks per second " << (uint64_t)CLOCKS_PER_SEC << ")" << std::endl;
-          result = false;
-          break;
-        }
-      } while ((hsa_signal_value_t) expectedValue != acquiredValue);
+      if (acquiredValue != (hsa_signal_value_t) expectedValue) {
+        context->Info() << "Signal '" << signalId << "' wait timed out, elapsed time: " << deadline.Elapsed() << " s" << std::endl;
+        result = false;
+      }
       context->Info() << "Signal '" << signalId << "' handle: " << std::hex << signal->Signal().handle << std::dec
                       << ", expected value: " << expectedValue << ", acquired value: " << acquiredValue << std::endl;
       return result;
@@ -1048,7 +1081,9 @@ class ImageRegionMatcher {
 HsailRuntimeContext::HsailRuntimeContext(Context* context)
   : RuntimeContext(context),
     hsaApi(context, context->Opts(), context->Opts()->GetString("rtlib", HSARUNTIMEDEFAULTNAME)),
-    queue(0), queueSize(0), queueError(false)
+    queue(0), queueSize(0), queueError(false), timestampFrequency(0), waitTime(0),
+    codeDir(context->Opts()->GetString("codecache", "")),
+    codeDirHits(0), codeDirMisses(0), codeDirTmpCount(0)
 {
 }
 
@@ -1163,6 +1198,8 @@ bool HsailRuntimeContext::Init() {
   wavesPerGroup = wgMaxSize / wavesize;
   status = Hsa()->hsa_system_get_info(HSA_SYSTEM_INFO_ENDIANNESS, &endianness);
   if (status != HSA_STATUS_SUCCESS) { HsaError("hsa_system_get_info failed", status); return false; }
+  status = Hsa()->hsa_system_get_info(HSA_SYSTEM_INFO_TIMESTAMP_FREQUENCY, &timestampFrequency);
+  if (status != HSA_STATUS_SUCCESS) { HsaError("hsa_system_get_info failed", status); return false; }
 
   kernargRegion = GetRegion(RegionMatchKernarg);
   if (!kernargRegion.handle) { context->Error() << "Failed to find kernarg region" << std::endl; return false; }
@@ -1170,6 +1207,8 @@ bool HsailRuntimeContext::Init() {
   systemRegion = GetRegion(RegionMatchSystem);
   if (!systemRegion.handle) { context->Error() << "Failed to find system region" << std::endl; return false; }
 
+  if (!CodeDirInit()) { return false; }
+
   context->Put("queueid", Value(MV_UINT32, Queue()->id));
   context->Put("queueptr", Value(context->IsLarge() ? MV_UINT64 : MV_UINT32, (uintptr_t) Queue()));
   return true;
@@ -1178,12 +1217,234 @@ bool HsailRuntimeContext::Init() {
 void HsailRuntimeContext::Dispose()
 {
   if (context) {
+    codeCache.Clear();
     QueueDestroy();
     Hsa()->hsa_shut_down();
     context = 0;
   }
 }
 
+void HsailRuntimeContext::Counters(CounterMap& counters) const
+{
+  if (codeCache.Hits() == 0 && codeCache.Misses() == 0) { return; }
+  AddCounter(counters, "code cache hits", COUNTER_SUM, codeCache.Hits());
+  AddCounter(counters, "code cache misses", COUNTER_SUM, codeCache.Misses());
+  if (HasCodeDir()) {
+    AddCounter(counters, "code cache directory hits", COUNTER_SUM, codeDirHits);
+    AddCounter(counters, "code cache directory misses", COUNTER_SUM, codeDirMisses);
+  }
+}
+
+bool HsailRuntimeContext::CodeDirInit()
+{
+  if (codeDir.empty()) { return true; }
+#ifdef _WIN32
+  if (!CreateDirectoryA(codeDir.c_str(), 0) && GetLastError() != ERROR_ALREADY_EXISTS) {
+#else
+  if (mkdir(codeDir.c_str(), 0777) != 0 && errno != EEXIST) {
+#endif // _WIN32
+    context->Error() << "Failed to create code cache directory " << codeDir << std::endl;
+    return false;
+  }
+  hsa_isa_t isa;
+  hsa_status_t status = Hsa()->hsa_agent_get_info(agent, HSA_AGENT_INFO_ISA, &isa);
+  if (status != HSA_STATUS_SUCCESS) { HsaError("hsa_agent_get_info(HSA_AGENT_INFO_ISA) failed", status); return false; }
+  uint32_t isaNameLength;
+  status = Hsa()->hsa_isa_get_info(isa, HSA_ISA_INFO_NAME_LENGTH, 0, &isaNameLength);
+  if (status != HSA_STATUS_SUCCESS) { HsaError("hsa_isa_get_info failed", status); return false; }
+  std::vector<char> isaName(isaNameLength + 1, '\0');
+  status = Hsa()->hsa_isa_get_info(isa, HSA_ISA_INFO_NAME, 0, isaName.data());
+  if (status != HSA_STATUS_SUCCESS) { HsaError("hsa_isa_get_info failed", status); return false; }
+  uint16_t versionMajor, versionMinor;
+  status = Hsa()->hsa_system_get_info(HSA_SYSTEM_INFO_VERSION_MAJOR, &versionMajor);
+  if (status != HSA_STATUS_SUCCESS) { HsaError("hsa_system_get_info failed", status); return false; }
+  status = Hsa()->hsa_system_get_info(HSA_SYSTEM_INFO_VERSION_MINOR, &versionMinor);
+  if (status != HSA_STATUS_SUCCESS) { HsaError("hsa_system_get_info failed", status); return false; }
+  // Finalizer comes with the runtime library, a rebuilt library may
+  // produce different code.
+  std::string library = hsaApi.LibraryPath();
+  std::ostringstream identity;
+  identity << "isa " << isaName.data() << "\n";
+  identity << "hsa " << versionMajor << "." << versionMinor << "\n";
+  identity << "library " << library;
+  struct stat st;
+  if (stat(library.c_str(), &st) == 0) {
+    identity << " " << (uint64_t) st.st_size << " " << (uint64_t) st.st_mtime;
+  }
+  identity << "\n";
+  codeDirIdentity = identity.str();
+  return true;
+}
+
+// Code cache file: magic, key length, key, serialized code object.
+static const char CODE_FILE_MAGIC[8] = { 'H', 'E', 'X', 'L', 'C', 'O', 'D', '1' };
+
+static hsa_status_t CodeFileAlloc(size_t size, hsa_callback_data_t data, void** address)
+{
+  *address = malloc(size);
+  return *address ? HSA_STATUS_SUCCESS : HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+}
+
+static std::string CodeFileName(const std::string& dir, uint64_t hash)
+{
+  return dir + "/" + TestHashString(hash) + ".hco";
+}
+
+CodeObjectCache::Code HsailRuntimeContext::LoadCodeFile(uint64_t hash, const std::string& key)
+{
+  std::ifstream in(CodeFileName(codeDir, hash).c_str(), std::ifstream::in | std::ifstream::binary);
+  std::string data;
+  if (in.is_open()) {
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  uint64_t keyLength = 0;
+  size_t header = sizeof(CODE_FILE_MAGIC) + sizeof(keyLength);
+  if (data.size() >= header) { memcpy(&keyLength, data.data() + sizeof(CODE_FILE_MAGIC), sizeof(keyLength)); }
+  // Files with other keys of the same hash are misses and are replaced.
+  if (data.size() < header ||
+      memcmp(data.data(), CODE_FILE_MAGIC, sizeof(CODE_FILE_MAGIC)) != 0 ||
+      keyLength != key.size() || data.size() - header <= keyLength ||
+      data.compare(header, key.size(), key) != 0) {
+    ++codeDirMisses;
+    return CodeObjectCache::Code();
+  }
+  size_t offset = header + key.size();
+  hsa_code_object_t code;
+  hsa_status_t status = Hsa()->hsa_code_object_deserialize(&data[offset], data.size() - offset, "", &code);
+  if (status != HSA_STATUS_SUCCESS) {
+    HsaError("hsa_code_object_deserialize failed", status);
+    ++codeDirMisses;
+    return CodeObjectCache::Code();
+  }
+  ++codeDirHits;
+  return ShareCode(code);
+}
+
+void HsailRuntimeContext::SaveCodeFile(uint64_t hash, const std::string& key, hsa_code_object_t code)
+{
+  void* serialized = 0;
+  size_t size = 0;
+  hsa_callback_data_t data;
+  data.handle = 0;
+  hsa_status_t status = Hsa()->hsa_code_object_serialize(code, CodeFileAlloc, data, "", &serialized, &size);
+  if (status != HSA_STATUS_SUCCESS) { HsaError("hsa_code_object_serialize failed", status); return; }
+  std::string name = CodeFileName(codeDir, hash);
+  // Unique temporary name: other threads and processes may write the same file.
+  std::ostringstream tmpName;
+#ifdef _WIN32
+  tmpName << name << ".tmp." << GetCurrentProcessId() << "." << codeDirTmpCount++;
+#else
+  tmpName << name << ".tmp." << getpid() << "." << codeDirTmpCount++;
+#endif // _WIN32
+  bool ok;
+  {
+    std::ofstream out(tmpName.str().c_str(), std::ofstream::out | std::ofstream::binary);
+    uint64_t keyLength = key.size();
+    out.write(CODE_FILE_MAGIC, sizeof(CODE_FILE_MAGIC));
+    out.write(reinterpret_cast<const char*>(&keyLength), sizeof(keyLength));
+    out.write(key.data(), key.size());
+    out.write(static_cast<const char*>(serialized), size);
+    out.close();
+    ok = !out.fail();
+  }
+  free(serialized);
+  if (ok) {
+#ifdef _WIN32
+    ok = MoveFileExA(tmpName.str().c_str(), name.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    ok = rename(tmpName.str().c_str(), name.c_str()) == 0;
+#endif // _WIN32
+  }
+  if (!ok) {
+    remove(tmpName.str().c_str());
+    context->Error() << "Failed to write code cache file " << name << std::endl;
+  }
+}
+
+CodeObjectCache::Code HsailRuntimeContext::ShareCode(hsa_code_object_t code)
+{
+  return CodeObjectCache::Code(new hsa_code_object_t(code), [this](hsa_code_object_t* code) {
+#ifndef _WIN32
+    // Temporarily disable due to crash on Windows.
+    hsa_status_t status = Hsa()->hsa_code_object_destroy(*code);
+    if (status != HSA_STATUS_SUCCESS) { HsaError("hsa_code_object_destroy failed", status); }
+#endif // _WIN32
+    delete code;
+  });
+}
+
+CodeObjectCache::Code CodeObjectCache::Find(uint64_t hash, const std::string& key)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto range = entries.equal_range(hash);
+  for (auto i = range.first; i != range.second; ++i) {
+    if (i->second.key == key) {
+      i->second.lastUse = ++useCount;
+      ++hits;
+      return i->second.code;
+    }
+  }
+  ++misses;
+  return Code();
+}
+
+void CodeObjectCache::Add(uint64_t hash, const std::string& key, const Code& code)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto range = entries.equal_range(hash);
+  for (auto i = range.first; i != range.second; ++i) {
+    // Finalized concurrently by another test.
+    if (i->second.key == key) { return; }
+  }
+  if (entries.size() >= CAPACITY) {
+    auto oldest = entries.begin();
+    for (auto i = entries.begin(); i != entries.end(); ++i) {
+      if (i->second.lastUse < oldest->second.lastUse) { oldest = i; }
+    }
+    entries.erase(oldest);
+  }
+  Entry e;
+  e.key = key;
+  e.code = code;
+  e.lastUse = ++useCount;
+  entries.insert(std::make_pair(hash, e));
+}
+
+void CodeObjectCache::Clear()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  entries.clear();
+}
+
+uint64_t HsailRuntimeContext::TimestampTicks(uint64_t ns) const
+{
+  return std::max<uint64_t>(timestampFrequency * ns / 1000000000, 1);
+}
+
+// Waits shorter than this are spun on, longer ones are blocked in slices
+// of WAIT_BLOCK_NS so that expired deadlines are noticed.
+static const uint64_t WAIT_SPIN_MAX_NS = 1000000;
+static const uint64_t WAIT_SPIN_MIN_NS = 20000;
+static const uint64_t WAIT_BLOCK_NS = 10000000;
+
+hsa_signal_value_t HsailRuntimeContext::SignalWait(hsa_signal_t signal, hsa_signal_value_t expected, const Watchdog::Deadline& deadline, bool stopOnQueueError)
+{
+  Watchdog::Clock::time_point start = Watchdog::Clock::now();
+  // Spin for about twice the average recent wait, unless waits are long.
+  uint64_t average = waitTime.load(std::memory_order_relaxed);
+  uint64_t spin = average < WAIT_SPIN_MAX_NS ? std::max(2 * average, WAIT_SPIN_MIN_NS) : WAIT_SPIN_MIN_NS;
+  hsa_signal_value_t value =
+    Hsa()->hsa_signal_wait_acquire(signal, HSA_SIGNAL_CONDITION_EQ, expected, TimestampTicks(spin), HSA_WAIT_STATE_ACTIVE);
+  while (value != expected && !deadline.Expired() && !(stopOnQueueError && queueError)) {
+    value = Hsa()->hsa_signal_wait_acquire(signal, HSA_SIGNAL_CONDITION_EQ, expected, TimestampTicks(WAIT_BLOCK_NS), HSA_WAIT_STATE_BLOCKED);
+  }
+  if (value == expected) {
+    uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(Watchdog::Clock::now() - start).count();
+    waitTime.store((average * 7 + time) / 8, std::memory_order_relaxed);
+  }
+  return value;
+}
+
 hsa_region_t HsailRuntimeContext::GetRegion(RegionMatch match)
 {
   hsa_region_t region;
@@ -20,12 +20,17 @@
 #include "RuntimeCommon.hpp"
 #include "Options.hpp"
 #include "DllApi.hpp"
+#include "HexlWatchdog.hpp"
 #include "hsa.h"
 #include "hsa_ext_finalize.h"
 #include "hsa_ext_image.h"
 #include "HSAILTool.h"
 #include "HSAILBrigContainer.h"
+#include <atomic>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #define HSAILRUNTIMEDEFAULTTIMEOUT 120
 
@@ -98,6 +103,18 @@ struct HsaApiTable {
     const char *options);
   hsa_status_t (*hsa_code_object_destroy)(
     hsa_code_object_t code_object);
+  hsa_status_t (*hsa_code_object_serialize)(
+    hsa_code_object_t code_object,
+    hsa_status_t (*alloc_callback)(size_t size, hsa_callback_data_t data, void **address),
+    hsa_callback_data_t callback_data,
+    const char *options,
+    void **serialized_code_object,
+    size_t *serialized_code_object_size);
+  hsa_status_t (*hsa_code_object_deserialize)(
+    void *serialized_code_object,
+    size_t serialized_code_object_size,
+    const char *options,
+    hsa_code_object_t *code_object);
   hsa_status_t (*hsa_executable_symbol_get_info)(
     hsa_executable_symbol_t executable_symbol,
     hsa_executable_symbol_info_t attribute,
@@ -152,6 +169,43 @@ public:
 
 class HsailRuntimeContext;
 
+/// Code objects finalized by the runtime, reused by tests which finalize
+/// the same modules with the same options. Key is the bytes of BRIG
+/// sections of all program modules and the finalization options; it is
+/// compared in full on lookup by its hash.
+class CodeObjectCache {
+public:
+  typedef std::shared_ptr<hsa_code_object_t> Code;
+
+private:
+  struct Entry {
+    std::string key;
+    Code code;
+    uint64_t lastUse;
+  };
+
+  static const size_t CAPACITY = 256;
+
+  std::mutex mutex;
+  std::unordered_multimap<uint64_t, Entry> entries;
+  uint64_t useCount;
+  std::atomic<uint64_t> hits, misses;
+
+public:
+  CodeObjectCache()
+    : useCount(0), hits(0), misses(0) { }
+
+  /// Returns cached code object or empty pointer, counting a hit or a miss.
+  Code Find(uint64_t hash, const std::string& key);
+  /// Adds code object, evicting the least recently used one if the
+  /// cache is full. Code objects still used by tests stay alive.
+  void Add(uint64_t hash, const std::string& key, const Code& code);
+  void Clear();
+
+  uint64_t Hits() const { return hits; }
+  uint64_t Misses() const { return misses; }
+};
+
 typedef std::function<bool(HsailRuntimeContext*, hsa_region_t)> RegionMatch;
 
 class HsailRuntimeContext : public runtime::RuntimeContext {
@@ -166,9 +220,19 @@ private:
   uint32_t wavesPerGroup;
   hsa_endianness_t endianness;
   hsa_region_t kernargRegion, systemRegion;
-
+  uint64_t timestampFrequency;
+  std::atomic<uint64_t> waitTime;
+  Watchdog watchdog;
+  CodeObjectCache codeCache;
+  std::string codeDir;
+  std::string codeDirIdentity;
+  std::atomic<uint64_t> codeDirHits, codeDirMisses;
+  std::atomic<uint32_t> codeDirTmpCount;
+
+  uint64_t TimestampTicks(uint64_t ns) const;
   bool QueueInit();
   void QueueDestroy();
+  bool CodeDirInit();
 
 public:
   HsailRuntimeContext(Context* context);
@@ -185,6 +249,7 @@ public:
 
   const Options* Opts() const { return context->Opts(); }
   virtual runtime::RuntimeState* NewState(Context* context);
+  void Counters(CounterMap& counters) const override;
 
   void HsaError(const char *msg, hsa_status_t err) {
     const char *hsamsg = "";
@@ -210,6 +275,27 @@ public:
   hsa_queue_t* QueueNoError();
   void QueueError(hsa_status_t status);
   bool IsQueueError() const { return queueError; }
+  Watchdog* SignalWatchdog() { return &watchdog; }
+  CodeObjectCache& CodeCache() { return codeCache; }
+  /// Takes ownership of finalized code object, which is destroyed
+  /// when the last reference to it is released.
+  CodeObjectCache::Code ShareCode(hsa_code_object_t code);
+  bool HasCodeDir() const { return !codeDir.empty(); }
+  /// Key of code object in code cache directory given by -codecache:
+  /// program key extended with identity of the agent ISA and the runtime
+  /// library, which are not part of the program.
+  std::string CodeDirKey(const std::string& programKey) const { return codeDirIdentity + programKey; }
+  /// Reads code object with key from code cache directory. Returns
+  /// empty pointer if there is no such code object.
+  CodeObjectCache::Code LoadCodeFile(uint64_t hash, const std::string& key);
+  /// Writes code object with key to code cache directory. The file is
+  /// written under a temporary name and renamed, so other processes
+  /// never see it partially written.
+  void SaveCodeFile(uint64_t hash, const std::string& key, hsa_code_object_t code);
+  /// Waits until signal has expected value, deadline expires or, if
+  /// stopOnQueueError is set, queue error occurs. Returns the last
+  /// acquired value.
+  hsa_signal_value_t SignalWait(hsa_signal_t signal, hsa_signal_value_t expected, const Watchdog::Deadline& deadline, bool stopOnQueueError);
 
   uint32_t QueueSize() const { return queue->size; }
   const HsaApi& Hsa() const { return hsaApi; }
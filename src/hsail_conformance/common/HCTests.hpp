@@ -22,6 +22,7 @@
 #include "BrigEmitter.hpp"
 #include "Scenario.hpp"
 #include "Grid.hpp"
+#include "HexlCoverage.hpp"
 
 namespace hsail_conformance {
 
@@ -83,53 +84,66 @@ public:
   //CoreConfig* CoreCfg() const { return context->Get<CoreConfig*>(CoreConfig::CONTEXT_KEY); }
 };
 
-template <typename T, typename P1>
-class TestAction1 : public hexl::Action<P1> {
-private:
+/// Action creating tests from items of a sequence and passing them to
+/// an iterator.
+template <typename P>
+class TestAction : public hexl::Action<P> {
+protected:
   std::string base;
-  hexl::TestSpecIterator& it;
+  hexl::TestSpecIterator* it;
 
 public:
-  explicit TestAction1(const std::string& base_, hexl::TestSpecIterator& it_) : base(base_), it(it_) { }
+  TestAction(const std::string& base_, hexl::TestSpecIterator& it_) : base(base_), it(&it_) { }
 
-  void operator()(const P1& p1) { it(base, new T(p1)); }
+  /// Passes tests created afterwards to it instead.
+  void SetIterator(hexl::TestSpecIterator& it) { this->it = &it; }
 };
 
-template <typename T, typename P1, typename P2>
-class TestAction2 : public hexl::Action<hexl::Pair<P1, P2>> {
+/// Only checks whether tests are valid in context, deleting them.
+class ValidityIterator : public hexl::TestSpecIterator {
 private:
-  std::string base;
-  hexl::TestSpecIterator& it;
+  hexl::Context* context;
+  bool valid;
 
 public:
-  TestAction2(const std::string& base_, hexl::TestSpecIterator& it_) : base(base_), it(it_) { }
+  explicit ValidityIterator(hexl::Context* context_) : context(context_), valid(false) { }
 
-  void operator()(const hexl::Pair<P1, P2>& p) { it(base, new T(p.First(), p.Second())); }
+  void operator()(const std::string& path, hexl::TestSpec* spec) { spec->InitContext(context); valid = spec->IsValid(); delete spec; }
+  /// Validity of the last test.
+  bool IsValid() const { return valid; }
 };
 
-template <typename T, typename P1, typename P2, typename P3>
-class TestAction3 : public hexl::Action<hexl::Pair<P1, hexl::Pair<P2, P3>>> {
-private:
-  std::string base;
-  hexl::TestSpecIterator& it;
+template <typename T, typename P1>
+class TestAction1 : public TestAction<P1> {
+public:
+  explicit TestAction1(const std::string& base_, hexl::TestSpecIterator& it_) : TestAction<P1>(base_, it_) { }
+
+  void operator()(const P1& p1) { (*this->it)(this->base, new T(p1)); }
+};
+
+template <typename T, typename P1, typename P2>
+class TestAction2 : public TestAction<hexl::Pair<P1, P2>> {
+public:
+  TestAction2(const std::string& base_, hexl::TestSpecIterator& it_) : TestAction<hexl::Pair<P1, P2>>(base_, it_) { }
+
+  void operator()(const hexl::Pair<P1, P2>& p) { (*this->it)(this->base, new T(p.First(), p.Second())); }
+};
 
+template <typename T, typename P1, typename P2, typename P3>
+class TestAction3 : public TestAction<hexl::Pair<P1, hexl::Pair<P2, P3>>> {
 public:
-  TestAction3(const std::string& base_, hexl::TestSpecIterator& it_) : base(base_), it(it_) { }
+  TestAction3(const std::string& base_, hexl::TestSpecIterator& it_) : TestAction<hexl::Pair<P1, hexl::Pair<P2, P3>>>(base_, it_) { }
 
-  void operator()(const hexl::Pair<P1, hexl::Pair<P2, P3>>& p) { it(base, new T(p.First(), p.Second().First(), p.Second().Second())); }
+  void operator()(const hexl::Pair<P1, hexl::Pair<P2, P3>>& p) { (*this->it)(this->base, new T(p.First(), p.Second().First(), p.Second().Second())); }
 };
 
 template <typename T, typename P1, typename P2, typename P3, typename P4>
-class TestAction4 : public hexl::Action<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, P4>>>> {
-private:
-  std::string base;
-  hexl::TestSpecIterator& it;
-
+class TestAction4 : public TestAction<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, P4>>>> {
 public:
-  TestAction4(const std::string& base_, hexl::TestSpecIterator& it_) : base(base_), it(it_) { }
+  TestAction4(const std::string& base_, hexl::TestSpecIterator& it_) : TestAction<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, P4>>>>(base_, it_) { }
 
   void operator()(const hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, P4>>>& p) {
-    it(base, new T(p.First(),
+    (*this->it)(this->base, new T(p.First(),
                    p.Second().First(),
                    p.Second().Second().First(),
                    p.Second().Second().Second()));
@@ -137,16 +151,12 @@ public:
 };
 
 template <typename T, typename P1, typename P2, typename P3, typename P4, typename P5>
-class TestAction5 : public hexl::Action<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, P5>>>>> {
-private:
-  std::string base;
-  hexl::TestSpecIterator& it;
-
+class TestAction5 : public TestAction<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, P5>>>>> {
 public:
-  TestAction5(const std::string& base_, hexl::TestSpecIterator& it_) : base(base_), it(it_) { }
+  TestAction5(const std::string& base_, hexl::TestSpecIterator& it_) : TestAction<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, P5>>>>>(base_, it_) { }
 
   void operator()(const hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, P5>>>>& p) {
-    it(base, new T(p.First(),
+    (*this->it)(this->base, new T(p.First(),
                    p.Second().First(),
                    p.Second().Second().First(),
                    p.Second().Second().Second().First(),
@@ -155,16 +165,12 @@ public:
 };
 
 template <typename T, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6>
-class TestAction6 : public hexl::Action<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, P6>>>>>> {
-private:
-  std::string base;
-  hexl::TestSpecIterator& it;
-
+class TestAction6 : public TestAction<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, P6>>>>>> {
 public:
-  TestAction6(const std::string& base_, hexl::TestSpecIterator& it_) : base(base_), it(it_) { }
+  TestAction6(const std::string& base_, hexl::TestSpecIterator& it_) : TestAction<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, P6>>>>>>(base_, it_) { }
 
   void operator()(const hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, P6>>>>>& p) {
-    it(base, new T(p.First(),
+    (*this->it)(this->base, new T(p.First(),
                    p.Second().First(),
                    p.Second().Second().First(),
                    p.Second().Second().Second().First(),
@@ -174,16 +180,12 @@ public:
 };
 
 template <typename T, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7>
-class TestAction7 : public hexl::Action<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, P7>>>>>>> {
-private:
-  std::string base;
-  hexl::TestSpecIterator& it;
-
+class TestAction7 : public TestAction<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, P7>>>>>>> {
 public:
-  TestAction7(const std::string& base_, hexl::TestSpecIterator& it_) : base(base_), it(it_) { }
+  TestAction7(const std::string& base_, hexl::TestSpecIterator& it_) : TestAction<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, P7>>>>>>>(base_, it_) { }
 
   void operator()(const hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, P7>>>>>>& p) {
-    it(base, new T(p.First(),
+    (*this->it)(this->base, new T(p.First(),
                    p.Second().First(),
                    p.Second().Second().First(),
                    p.Second().Second().Second().First(),
@@ -194,16 +196,12 @@ public:
 };
 
 template <typename T, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8>
-class TestAction8 : public hexl::Action<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, P8>>>>>>>> {
-private:
-  std::string base;
-  hexl::TestSpecIterator& it;
-
+class TestAction8 : public TestAction<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, P8>>>>>>>> {
 public:
-  TestAction8(const std::string& base_, hexl::TestSpecIterator& it_) : base(base_), it(it_) { }
+  TestAction8(const std::string& base_, hexl::TestSpecIterator& it_) : TestAction<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, P8>>>>>>>>(base_, it_) { }
 
   void operator()(const hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, P8>>>>>>>& p) {
-    it(base, new T(p.First(),
+    (*this->it)(this->base, new T(p.First(),
                    p.Second().First(),
                    p.Second().Second().First(),
                    p.Second().Second().Second().First(),
@@ -215,16 +213,12 @@ public:
 };
 
 template <typename T, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8, typename P9>
-class TestAction9 : public hexl::Action<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, hexl::Pair<P8, P9>>>>>>>>> {
-private:
-  std::string base;
-  hexl::TestSpecIterator& it;
-
+class TestAction9 : public TestAction<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, hexl::Pair<P8, P9>>>>>>>>> {
 public:
-  TestAction9(const std::string& base_, hexl::TestSpecIterator& it_) : base(base_), it(it_) { }
+  TestAction9(const std::string& base_, hexl::TestSpecIterator& it_) : TestAction<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, hexl::Pair<P8, P9>>>>>>>>>(base_, it_) { }
 
   void operator()(const hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, hexl::Pair<P8, P9>>>>>>>>& p) {
-    it(base, new T(p.First(),
+    (*this->it)(this->base, new T(p.First(),
                    p.Second().First(),
                    p.Second().Second().First(),
                    p.Second().Second().Second().First(),
@@ -237,16 +231,12 @@ public:
 };
 
 template <typename T, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8, typename P9, typename P10>
-class TestAction10 : public hexl::Action<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, hexl::Pair<P8, hexl::Pair<P9, P10>>>>>>>>>> {
-private:
-  std::string base;
-  hexl::TestSpecIterator& it;
-
+class TestAction10 : public TestAction<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, hexl::Pair<P8, hexl::Pair<P9, P10>>>>>>>>>> {
 public:
-  TestAction10(const std::string& base_, hexl::TestSpecIterator& it_) : base(base_), it(it_) { }
+  TestAction10(const std::string& base_, hexl::TestSpecIterator& it_) : TestAction<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, hexl::Pair<P8, hexl::Pair<P9, P10>>>>>>>>>>(base_, it_) { }
 
   void operator()(const hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, hexl::Pair<P8, hexl::Pair<P9, P10>>>>>>>>>& p) {
-    it(base, new T(p.First(),
+    (*this->it)(this->base, new T(p.First(),
                    p.Second().First(),
                    p.Second().Second().First(),
                    p.Second().Second().Second().First(),
@@ -260,16 +250,12 @@ public:
 };
 
 template <typename T, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8, typename P9, typename P10, typename P11>
-class TestAction11 : public hexl::Action<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, hexl::Pair<P8, hexl::Pair<P9, hexl::Pair<P10, P11>>>>>>>>>>> {
-private:
-  std::string base;
-  hexl::TestSpecIterator& it;
-
+class TestAction11 : public TestAction<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, hexl::Pair<P8, hexl::Pair<P9, hexl::Pair<P10, P11>>>>>>>>>>> {
 public:
-  TestAction11(const std::string& base_, hexl::TestSpecIterator& it_) : base(base_), it(it_) { }
+  TestAction11(const std::string& base_, hexl::TestSpecIterator& it_) : TestAction<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, hexl::Pair<P8, hexl::Pair<P9, hexl::Pair<P10, P11>>>>>>>>>>>(base_, it_) { }
 
   void operator()(const hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, hexl::Pair<P8, hexl::Pair<P9, hexl::Pair<P10, P11>>>>>>>>>>& p) {
-    it(base, new T(p.First(),
+    (*this->it)(this->base, new T(p.First(),
                    p.Second().First(),
                    p.Second().Second().First(),
                    p.Second().Second().Second().First(),
@@ -284,16 +270,12 @@ public:
 };
 
 template <typename T, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8, typename P9, typename P10, typename P11, typename P12>
-class TestAction12 : public hexl::Action<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, hexl::Pair<P8, hexl::Pair<P9, hexl::Pair<P10, hexl::Pair<P11, P12>>>>>>>>>>>> {
-private:
-  std::string base;
-  hexl::TestSpecIterator& it;
-
+class TestAction12 : public TestAction<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, hexl::Pair<P8, hexl::Pair<P9, hexl::Pair<P10, hexl::Pair<P11, P12>>>>>>>>>>>> {
 public:
-  TestAction12(const std::string& base_, hexl::TestSpecIterator& it_) : base(base_), it(it_) { }
+  TestAction12(const std::string& base_, hexl::TestSpecIterator& it_) : TestAction<hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, hexl::Pair<P8, hexl::Pair<P9, hexl::Pair<P10, hexl::Pair<P11, P12>>>>>>>>>>>>(base_, it_) { }
 
   void operator()(const hexl::Pair<P1, hexl::Pair<P2, hexl::Pair<P3, hexl::Pair<P4, hexl::Pair<P5, hexl::Pair<P6, hexl::Pair<P7, hexl::Pair<P8, hexl::Pair<P9, hexl::Pair<P10, hexl::Pair<P11, P12>>>>>>>>>>>& p) {
-    it(base, new T(p.First(),
+    (*this->it)(this->base, new T(p.First(),
                    p.Second().First(),
                    p.Second().Second().First(),
                    p.Second().Second().Second().First(),
@@ -308,11 +290,66 @@ public:
   }
 };
 
+/// Applies action to items of sequence in order. Items are accessed by
+/// index, so tests which the iterator skips are not created.
+///
+/// If ps is the product of sequences with numbers of items given by axes
+/// and the iterator asks for coverage, only items of a covering array of
+/// the product are applied. Rows with tests which are not valid in the
+/// coverage context are replaced by valid rows covering the same tuples.
+/// If the iterator asks for a sample, only that many items drawn at random
+/// with seed mixed from the iterator seed and base are applied.
+template <typename P>
+void TestForEachIndex(hexl::TestSpecIterator& it, const std::string& base, hexl::Sequence<P>* ps, TestAction<P>& a, const std::vector<uint64_t>& axes = std::vector<uint64_t>())
+{
+  std::vector<uint64_t> indexes;
+  bool reduced = false;
+  unsigned strength = it.Coverage();
+  if (strength > 0 && axes.size() > strength) {
+    hexl::Context* context = it.CoverageContext();
+    if (context) {
+      ValidityIterator validity(context);
+      a.SetIterator(validity);
+      hexl::ValidCoveringArray(axes, strength, [&](uint64_t index) { ps->At(index, a); return validity.IsValid(); }, indexes);
+      a.SetIterator(it);
+    } else {
+      hexl::CoveringArray(axes, strength, indexes);
+    }
+    reduced = true;
+  }
+  unsigned sample = it.Sample();
+  uint64_t total = reduced ? indexes.size() : ps->Count();
+  if (sample > 0 && sample < total) {
+    std::vector<uint64_t> drawn;
+    hexl::SampleIndexes(total, sample, hexl::MixSeed(it.SampleSeed(), base), drawn);
+    if (reduced) {
+      for (uint64_t& i : drawn) { i = indexes[i]; }
+    }
+    indexes.swap(drawn);
+    reduced = true;
+  }
+  if (reduced) {
+    uint64_t count = indexes.size();
+    uint64_t i = 0;
+    while (i < count) {
+      i += it.Skip(count - i);
+      if (i < count) { ps->At(indexes[i++], a); }
+    }
+    return;
+  }
+  uint64_t count = ps->Count();
+  uint64_t i = 0;
+  while (i < count) {
+    i += it.Skip(count - i);
+    if (i < count) { ps->At(i++, a); }
+  }
+}
+
 template <typename Test, typename P1>
 void TestForEach(hexl::Arena* ap, hexl::TestSpecIterator& it, const std::string& base, hexl::Sequence<P1>* p1s)
 {
   TestAction1<Test, P1> a(base, it);
-  p1s->Iterate(a);
+  TestForEachIndex(it, base, p1s, a);
 }
 
 template <typename Test, typename P1, typename P2>
@@ -320,7 +357,7 @@ void TestForEach(hexl::Arena* ap, hexl::TestSpecIterator& it, const std::string&
 {
   TestAction2<Test, P1, P2> a(base, it);
   auto ps = SequenceProduct(ap, p1s, p2s);
-  ps->Iterate(a);
+  TestForEachIndex(it, base, ps, a, { p1s->Count(), p2s->Count() });
 }
 
 template <typename Test, typename P1, typename P2, typename P3>
@@ -328,7 +365,7 @@ void TestForEach(hexl::Arena* ap, hexl::TestSpecIterator& it, const std::string&
 {
   TestAction3<Test, P1, P2, P3> a(base, it);
   auto ps = SequenceProduct(ap, p1s, p2s, p3s);
-  ps->Iterate(a);
+  TestForEachIndex(it, base, ps, a, { p1s->Count(), p2s->Count(), p3s->Count() });
 }
 
 template <typename Test, typename P1, typename P2, typename P3, typename P4>
@@ -336,7 +373,7 @@ void TestForEach(hexl::Arena* ap, hexl::TestSpecIterator& it, const std::string&
 {
   TestAction4<Test, P1, P2, P3, P4> a(base, it);
   auto ps = SequenceProduct(ap, p1s, p2s, p3s, p4s);
-  ps->Iterate(a);
+  TestForEachIndex(it, base, ps, a, { p1s->Count(), p2s->Count(), p3s->Count(), p4s->Count() });
 }
 
 template <typename Test, typename P1, typename P2, typename P3, typename P4, typename P5>
@@ -344,7 +381,7 @@ void TestForEach(hexl::Arena* ap, hexl::TestSpecIterator& it, const std::string&
 {
   TestAction5<Test, P1, P2, P3, P4, P5> a(base, it);
   auto ps = SequenceProduct(ap, p1s, p2s, p3s, p4s, p5s);
-  ps->Iterate(a);
+  TestForEachIndex(it, base, ps, a, { p1s->Count(), p2s->Count(), p3s->Count(), p4s->Count(), p5s->Count() });
 }
 
 template <typename Test, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6>
@@ -352,7 +389,7 @@ void TestForEach(hexl::Arena* ap, hexl::TestSpecIterator& it, const std::string&
 {
   TestAction6<Test, P1, P2, P3, P4, P5, P6> a(base, it);
   auto ps = SequenceProduct(ap, p1s, p2s, p3s, p4s, p5s, p6s);
-  ps->Iterate(a);
+  TestForEachIndex(it, base, ps, a, { p1s->Count(), p2s->Count(), p3s->Count(), p4s->Count(), p5s->Count(), p6s->Count() });
 }
 
 template <typename Test, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7>
@@ -360,7 +397,7 @@ void TestForEach(hexl::Arena* ap, hexl::TestSpecIterator& it, const std::string&
 {
   TestAction7<Test, P1, P2, P3, P4, P5, P6, P7> a(base, it);
   auto ps = SequenceProduct(ap, p1s, p2s, p3s, p4s, p5s, p6s, p7s);
-  ps->Iterate(a);
+  TestForEachIndex(it, base, ps, a, { p1s->Count(), p2s->Count(), p3s->Count(), p4s->Count(), p5s->Count(), p6s->Count(), p7s->Count() });
 }
 
 template <typename Test, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8>
@@ -368,7 +405,7 @@ void TestForEach(hexl::Arena* ap, hexl::TestSpecIterator& it, const std::string&
 {
   TestAction8<Test, P1, P2, P3, P4, P5, P6, P7, P8> a(base, it);
   auto ps = SequenceProduct(ap, p1s, p2s, p3s, p4s, p5s, p6s, p7s, p8s);
-  ps->Iterate(a);
+  TestForEachIndex(it, base, ps, a, { p1s->Count(), p2s->Count(), p3s->Count(), p4s->Count(), p5s->Count(), p6s->Count(), p7s->Count(), p8s->Count() });
 }
 
 template <typename Test, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8, typename P9>
@@ -376,7 +413,7 @@ void TestForEach(hexl::Arena* ap, hexl::TestSpecIterator& it, const std::string&
 {
   TestAction9<Test, P1, P2, P3, P4, P5, P6, P7, P8, P9> a(base, it);
   auto ps = SequenceProduct(ap, p1s, p2s, p3s, p4s, p5s, p6s, p7s, p8s, p9s);
-  ps->Iterate(a);
+  TestForEachIndex(it, base, ps, a, { p1s->Count(), p2s->Count(), p3s->Count(), p4s->Count(), p5s->Count(), p6s->Count(), p7s->Count(), p8s->Count(), p9s->Count() });
 }
 
 template <typename Test, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8, typename P9, typename P10>
@@ -384,7 +421,7 @@ void TestForEach(hexl::Arena* ap, hexl::TestSpecIterator& it, const std::string&
 {
   TestAction10<Test, P1, P2, P3, P4, P5, P6, P7, P8, P9, P10> a(base, it);
   auto ps = SequenceProduct(ap, p1s, p2s, p3s, p4s, p5s, p6s, p7s, p8s, p9s, p10s);
-  ps->Iterate(a);
+  TestForEachIndex(it, base, ps, a, { p1s->Count(), p2s->Count(), p3s->Count(), p4s->Count(), p5s->Count(), p6s->Count(), p7s->Count(), p8s->Count(), p9s->Count(), p10s->Count() });
 }
 
 template <typename Test, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8, typename P9, typename P10, typename P11>
@@ -392,7 +429,7 @@ void TestForEach(hexl::Arena* ap, hexl::TestSpecIterator& it, const std::string&
 {
   TestAction11<Test, P1, P2, P3, P4, P5, P6, P7, P8, P9, P10, P11> a(base, it);
   auto ps = SequenceProduct(ap, p1s, p2s, p3s, p4s, p5s, p6s, p7s, p8s, p9s, p10s, p11s);
-  ps->Iterate(a);
+  TestForEachIndex(it, base, ps, a, { p1s->Count(), p2s->Count(), p3s->Count(), p4s->Count(), p5s->Count(), p6s->Count(), p7s->Count(), p8s->Count(), p9s->Count(), p10s->Count(), p11s->Count() });
 }
 
 template <typename Test, typename P1, typename P2, typename P3, typename P4, typename P5, typename P6, typename P7, typename P8, typename P9, typename P10, typename P11, typename P12>
@@ -400,7 +437,7 @@ void TestForEach(hexl::Arena* ap, hexl::TestSpecIterator& it, const std::string&
 {
   TestAction12<Test, P1, P2, P3, P4, P5, P6, P7, P8, P9, P10, P11, P12> a(base, it);
   auto ps = SequenceProduct(ap, p1s, p2s, p3s, p4s, p5s, p6s, p7s, p8s, p9s, p10s, p11s, p12s);
-  ps->Iterate(a);
+  TestForEachIndex(it, base, ps, a, { p1s->Count(), p2s->Count(), p3s->Count(), p4s->Count(), p5s->Count(), p6s->Count(), p7s->Count(), p8s->Count(), p9s->Count(), p10s->Count(), p11s->Count(), p12s->Count() });
 }
 
 }
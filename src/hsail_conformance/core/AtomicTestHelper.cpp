@@ -20,7 +20,10 @@ namespace hsail_conformance {
 
 //=====================================================================================
 
-unsigned AtomicTestHelper::wavesize;
+AtomicTestHelper::~AtomicTestHelper()
+{
+    for (TestProp* prop : props) delete prop;
+}
 
 //=====================================================================================
 
@@ -22,6 +22,7 @@
 #include "BrigEmitter.hpp"
 #include "HCTests.hpp"
 #include "Scenario.hpp"
+#include <vector>
 
 using namespace hexl;
 using namespace hexl::scenario;
@@ -43,11 +44,46 @@ namespace hsail_conformance {
 
 //=====================================================================================
 
-class AtomicTestHelper : public Test
+class TestProp;
+
+// Grid of a test together with wavesize of the agent it was built for.
+// Tests need wavesize to choose test kind when they are constructed.
+struct WaveGrid
+{
+    Grid     geometry;
+    unsigned wavesize;
+
+    WaveGrid(Grid geometry_ = 0, unsigned wavesize_ = 0) : geometry(geometry_), wavesize(wavesize_) {}
+};
+
+// Pairs every grid of a sequence with the same wavesize.
+class WaveGridSequence : public hexl::Sequence<WaveGrid>
 {
+private:
+    class GridAction : public hexl::Action<Grid>
+    {
+    private:
+        hexl::Action<WaveGrid>& a;
+        unsigned wavesize;
+
+    public:
+        GridAction(hexl::Action<WaveGrid>& a_, unsigned wavesize_) : a(a_), wavesize(wavesize_) {}
+        void operator()(const Grid& geometry) { a(WaveGrid(geometry, wavesize)); }
+    };
+
+    hexl::Sequence<Grid>* grids;
+    unsigned wavesize;
+
 public:
-    static unsigned wavesize;
+    WaveGridSequence(hexl::Sequence<Grid>* grids_, unsigned wavesize_) : grids(grids_), wavesize(wavesize_) {}
 
+    void Iterate(hexl::Action<WaveGrid>& a) const { GridAction ga(a, wavesize); grids->Iterate(ga); }
+    uint64_t Count() const { return grids->Count(); }
+    void At(uint64_t index, hexl::Action<WaveGrid>& a) const { GridAction ga(a, wavesize); grids->At(index, ga); }
+};
+
+class AtomicTestHelper : public Test
+{
 protected:
     static const unsigned TEST_KIND_WAVE   = 1;
     static const unsigned TEST_KIND_WGROUP = 2;
@@ -57,20 +93,27 @@ protected:
     static const BrigType WG_COMPLETE_TYPE = BRIG_TYPE_U32; // Type of elements in "group_complete" array
 
 protected:
+    unsigned            wavesize;
     unsigned            testKind;
 
 protected:
     DirectiveVariable   wgComplete;                         
     PointerReg          wgCompleteAddr;
 
+private:
+    std::vector<TestProp*> props;                           // owned by this test
+
 public:
-    AtomicTestHelper(Location codeLocation, Grid geometry) : 
-        Test(codeLocation, geometry),
+    AtomicTestHelper(Location codeLocation, WaveGrid grid) : 
+        Test(codeLocation, grid.geometry),
+        wavesize(grid.wavesize),
         wgCompleteAddr(0)
     {
     }
 
-    virtual ~AtomicTestHelper() {}
+    virtual ~AtomicTestHelper();
+
+    void AddProp(TestProp* prop) { props.push_back(prop); }
 
     // ========================================================================
 public:
@@ -960,6 +1003,8 @@ protected:
 //=====================================================================================
 //=====================================================================================
 
+// Properties are created for every test and owned by it, so that tests
+// can be emitted after iteration and on several threads.
 template<class Prop, unsigned size = 1> class TestPropFactory
 {
 private: 
@@ -967,22 +1012,16 @@ private:
 
 private:
     static const unsigned ATOMIC_OPS = BRIG_ATOMIC_XOR + 1; //F
-    Prop* prop[ATOMIC_OPS];
 
 public:
     TestPropFactory(unsigned dim = 0)
     { 
         assert(dim < size);
 
-        for (unsigned i = 0; i < ATOMIC_OPS; ++i) prop[i] = 0;
-
         factory[dim] = this;
     }
 
-    virtual ~TestPropFactory() 
-    { 
-        for (unsigned i = 0; i < ATOMIC_OPS; ++i) delete prop[i]; 
-    }
+    virtual ~TestPropFactory() {}
 
 public:
     Prop* GetProp(AtomicTestHelper* test, 
@@ -998,10 +1037,11 @@ public:
     {
         assert(0 <= op && op < ATOMIC_OPS);
 
-        if (prop[op] == 0) prop[op] = CreateProp(op);
-        prop[op]->SetMemOpProps(op, seg, order, scope, type, eqClass, isNoRet, isPlainOp, arrayId);
-        prop[op]->setup(test);
-        return prop[op];
+        Prop* prop = CreateProp(op);
+        prop->SetMemOpProps(op, seg, order, scope, type, eqClass, isNoRet, isPlainOp, arrayId);
+        prop->setup(test);
+        test->AddProp(prop);
+        return prop;
     }
 
     Prop* GetProp(AtomicTestHelper* test, MemOpProp& op)
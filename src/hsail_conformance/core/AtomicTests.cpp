@@ -601,7 +601,7 @@ private:
     // ========================================================================
 
 public:
-    AtomicTest(Grid geometry,
+    AtomicTest(WaveGrid grid,
                 BrigAtomicOperation atomicOp,
                 BrigSegment segment,
                 BrigMemoryOrder memoryOrder,
@@ -609,7 +609,7 @@ public:
                 BrigType type,
                 bool mapFlat2Grp,
                 bool noret)
-    : AtomicTestHelper(KERNEL, geometry),
+    : AtomicTestHelper(KERNEL, grid),
         mapFlat2Group(mapFlat2Grp),
         atomicVarAddr(0),
         resArrayAddr(0),
@@ -1099,12 +1099,11 @@ public:
 
 void AtomicTests::Iterate(hexl::TestSpecIterator& it)
 {
-    AtomicTestPropFactory singleton;
+    static AtomicTestPropFactory singleton;
     CoreConfig* cc = CoreConfig::Get(context);
-    AtomicTest::wavesize = cc->Wavesize(); //F: how to get the value from inside of AtomicTest?
     Arena* ap = cc->Ap();
     TestForEach<AtomicTest>(ap, it, "atomicity", 
-                            cc->Grids().AtomicSet(),          // grid
+                            NEWA WaveGridSequence(cc->Grids().AtomicSet(), cc->Wavesize()), // grid
                             cc->Memory().AllAtomics(),        // atomic op
                             cc->Segments().Atomic(),          // segment
                             cc->Memory().AllMemoryOrders(),   // order
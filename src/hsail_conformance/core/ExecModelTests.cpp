@@ -82,8 +82,8 @@ private:
 //=====================================================================================
 public:
 
-    ExecModelTest(Grid geometry)
-    : AtomicTestHelper(KERNEL, geometry),
+    ExecModelTest(WaveGrid grid)
+    : AtomicTestHelper(KERNEL, grid),
         resArrayAddr(0),
         indexInResArray(0)
     {
@@ -210,9 +210,8 @@ public:
 void ExecModelTests::Iterate(hexl::TestSpecIterator& it)
 {
     CoreConfig* cc = CoreConfig::Get(context);
-    ExecModelTest::wavesize = cc->Wavesize(); //F: how to get the value from inside of AtomicTest?
     Arena* ap = cc->Ap();
-    TestForEach<ExecModelTest>(ap, it, "execmodel", cc->Grids().EModelSet());
+    TestForEach<ExecModelTest>(ap, it, "execmodel", NEWA WaveGridSequence(cc->Grids().EModelSet(), cc->Wavesize()));
 }
 
 //=====================================================================================
@@ -584,7 +584,7 @@ public:
 
 #ifdef QUICK_TEST
 
-    MModelTest(Grid                 geometry,
+    MModelTest(WaveGrid             grid,
                BrigSegment          sync_seg,
                BrigMemoryOrder      sync_order,
                BrigMemoryScope      sync_scope,
@@ -595,7 +595,7 @@ public:
                BrigMemoryScope      hb_scope,
                bool                 hb_plain
                )
-    : AtomicTestHelper(KERNEL, geometry),
+    : AtomicTestHelper(KERNEL, grid),
         resArrayAddr(0),
         indexInResArray(0),
         resultFlag(0),
@@ -724,7 +724,7 @@ public:
 
 #else
 
-    MModelTest(Grid                 geometry_,
+    MModelTest(WaveGrid             grid,
                BrigAtomicOperation  hb_op,
                BrigAtomicOperation  sync_op,
                BrigSegment          hb_seg,
@@ -737,7 +737,7 @@ public:
                BrigType             sync_type,
                bool                 hb_plain
                )
-    : AtomicTestHelper(KERNEL, geometry_),
+    : AtomicTestHelper(KERNEL, grid),
         resArrayAddr(0),
         indexInResArray(0),
         resultFlag(0),
@@ -1530,14 +1530,13 @@ public:
 
 void MModelTests::Iterate(hexl::TestSpecIterator& it)
 {
-    MModelTestPropFactory first(0);
-    MModelTestPropFactory second(1);
+    static MModelTestPropFactory first(0);
+    static MModelTestPropFactory second(1);
 
     CoreConfig* cc = CoreConfig::Get(context);
-    MModelTest::wavesize = cc->Wavesize(); //F: how to get the value from inside of AtomicTest?
     Arena* ap = cc->Ap();
 
-    TestForEach<MModelTest>(ap, it, "mmodel", cc->Grids().MModelSet(),
+    TestForEach<MModelTest>(ap, it, "mmodel", NEWA WaveGridSequence(cc->Grids().MModelSet(), cc->Wavesize()),
                                                                 // "synchronized-with" properties:
                             cc->Segments().Atomic(),            //  - segment
                             cc->Memory().AllMemoryOrders(),     //  - order
@@ -1556,15 +1555,14 @@ void MModelTests::Iterate(hexl::TestSpecIterator& it)
 
 void MModelTests::Iterate(hexl::TestSpecIterator& it)
 {
-    MModelTestPropFactory first(0);
-    MModelTestPropFactory second(1);
+    static MModelTestPropFactory first(0);
+    static MModelTestPropFactory second(1);
 
     CoreConfig* cc = CoreConfig::Get(context);
-    MModelTest::wavesize = cc->Wavesize(); //F: how to get the value from inside of AtomicTest?
     Arena* ap = cc->Ap();
 
     TestForEach<MModelTest>(ap, it, "mmodel", 
-                            cc->Grids().MModelSet(),                                            // grid
+                            NEWA WaveGridSequence(cc->Grids().MModelSet(), cc->Wavesize()),     // grid
                             cc->Memory().AllAtomics(),      cc->Memory().AllAtomics(),          // op
                             cc->Segments().Atomic(),        cc->Segments().Atomic(),            // segment
                             cc->Memory().AllMemoryOrders(), cc->Memory().AllMemoryOrders(),     // order
@@ -17,8 +17,16 @@
 #include "Options.hpp"
 #include "HexlTestFactory.hpp"
 #include "HexlTestRunner.hpp"
+#include "HexlTestPool.hpp"
+#include "HexlTestBudget.hpp"
+#include "HexlHash.hpp"
 #include <iostream>
 #include <memory>
+#include <chrono>
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include <vector>
 #include "HexlResource.hpp"
 
 #include "PrmCoreTests.hpp"
@@ -31,6 +39,7 @@
 #include "CoreConfig.hpp"
 #include "SignalTests.hpp"
 #include "Brig.h"
+#include "HSAILBrigContainer.h"
 
 using namespace hexl;
 using namespace hexl::emitter;
@@ -67,6 +76,7 @@ class HCTestFactory : public DefaultTestFactory {
 private:
   Context* context;
   hexl::TestSetUnion* hsaTests;
+  std::unique_ptr<TestSet> filteredTests;
 
 public:
   HCTestFactory(Context* context_)
@@ -76,6 +86,7 @@ public:
 
   ~HCTestFactory()
   {
+    filteredTests.reset();
     delete hsaTests;
   }
 
@@ -95,6 +106,7 @@ public:
         TestSet* fts = hsaTests->Filter(filter);
         if (fts != ts) {
           fts->InitContext(context);
+          filteredTests.reset(fts);
           ts = fts;
         }
       }
@@ -110,9 +122,7 @@ public:
       testFactory(new HCTestFactory(context.get())), runner(0),
       coreConfig(0)
   {
-    context->Put("hexl.log.stream.debug", &std::cout);
-    context->Put("hexl.log.stream.info", &std::cout);
-    context->Put("hexl.log.stream.error", &std::cout);
+    SetLogStreams(&std::cout);
   }
   ~HCRunner()
   { 
@@ -121,6 +131,7 @@ public:
   }
 
   void Run();
+  void WorkerArgs(std::vector<std::string>& args);
 
 private:
   int argc;
@@ -130,10 +141,186 @@ private:
   TestFactory* testFactory;
   TestRunner* runner;
   CoreConfig* coreConfig;
+  std::unique_ptr<AsyncLogWriter> logWriter;
+  std::unique_ptr<AsyncLogStream> logStream;
+  // Test sets created by CreateTestSet() over those of the factory.
+  std::vector<std::unique_ptr<TestSet>> createdTests;
   TestRunner* CreateTestRunner();
   TestSet* CreateTestSet();
+  runtime::RuntimeContext* CreateConfigRuntime();
+  void ReleaseConfigRuntime(runtime::RuntimeContext* runtime);
+  /// True if tests are run by test workers (-jobs or -isolate).
+  bool UseWorkers() const { return options.GetUnsigned("jobs", 1) > 1 || options.GetBoolean("isolate"); }
+  void ListTests();
+  int RunWorker(TestProcessPool* pool);
+  bool CheckEmission(unsigned threads);
+  void SetLogStreams(std::ostream* out);
+  void StartLog();
+  void StopLog();
 };
 
+class HCTestPool : public TestProcessPool {
+private:
+  HCRunner* hcr;
+
+public:
+  HCTestPool(Context* context_, unsigned jobs_, HCRunner* hcr_)
+    : TestProcessPool(context_, jobs_), hcr(hcr_) { }
+
+  virtual void WorkerArgs(std::vector<std::string>& args) { hcr->WorkerArgs(args); }
+};
+
+/// Hash64 of BRIG modules in the context of created test.
+static uint64_t EmittedBrigHash(Test* test)
+{
+  Hash64 hash;
+  if (!test) { return hash.Get(); }
+  std::vector<std::string> keys;
+  test->GetContext()->Keys(keys);
+  for (const std::string& key : keys) {
+    if (key.size() < 5 || key.compare(key.size() - 5, 5, ".brig") != 0) { continue; }
+    BrigModule_t module = test->GetContext()->Get<HSAIL_ASM::BrigContainer>(key)->getBrigModule();
+    const char* base = reinterpret_cast<const char*>(module);
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(base + module->sectionIndex);
+    hash.Add(key);
+    for (uint32_t i = 0; i < module->sectionCount; ++i) {
+      const BrigSectionHeader* section = reinterpret_cast<const BrigSectionHeader*>(base + offsets[i]);
+      hash.Add(section, (size_t) section->byteCount);
+    }
+  }
+  return hash.Get();
+}
+
+/// Emits tests on one thread, then again on several threads, and checks
+/// that every test emits the same BRIG both times (-emitcheck).
+class EmissionCheck {
+private:
+  class SerialEmitter : public TestSpecIterator {
+  private:
+    EmissionCheck* check;
+
+  public:
+    explicit SerialEmitter(EmissionCheck* check_) : check(check_) { }
+    void operator()(const std::string& path, TestSpec* spec) override { check->EmitSerial(spec); }
+  };
+
+  class ParallelEmitter : public TestSpecIterator {
+  private:
+    EmissionCheck* check;
+
+  public:
+    explicit ParallelEmitter(EmissionCheck* check_) : check(check_) { }
+    void operator()(const std::string& path, TestSpec* spec) override { check->Add(path, spec); }
+  };
+
+  // Specs are created ahead of emission, keep only a batch of them at once.
+  static const size_t BATCH_PER_THREAD = 64;
+
+  Context* context;
+  unsigned threads;
+  std::vector<uint64_t> serialHashes;
+  std::vector<std::pair<std::string, TestSpec*>> batch;
+  size_t checked;
+  size_t mismatches;
+
+  void EmitSerial(TestSpec* spec);
+  void Add(const std::string& path, TestSpec* spec);
+  void EmitBatch();
+
+public:
+  EmissionCheck(Context* context_, unsigned threads_)
+    : context(context_), threads(threads_), checked(0), mismatches(0) { }
+
+  bool Run(TestSet& tests);
+};
+
+void EmissionCheck::EmitSerial(TestSpec* spec)
+{
+  spec->InitContext(context);
+  if (!spec->IsValid()) { delete spec; return; }
+  Test* test = spec->Create();
+  serialHashes.push_back(EmittedBrigHash(test));
+  if (test) { delete test; }
+  delete spec;
+}
+
+void EmissionCheck::Add(const std::string& path, TestSpec* spec)
+{
+  spec->InitContext(context);
+  if (!spec->IsValid()) { delete spec; return; }
+  batch.push_back(std::make_pair(path + "/" + spec->TestName(), spec));
+  if (batch.size() >= threads * BATCH_PER_THREAD) { EmitBatch(); }
+}
+
+void EmissionCheck::EmitBatch()
+{
+  std::vector<uint64_t> hashes(batch.size());
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < threads; ++i) {
+    workers.push_back(std::thread([this, &hashes, &next]() {
+      size_t j;
+      while ((j = next++) < batch.size()) {
+        Test* test = batch[j].second->Create();
+        hashes[j] = EmittedBrigHash(test);
+        if (test) { delete test; }
+        delete batch[j].second;
+      }
+    }));
+  }
+  for (std::thread& worker : workers) { worker.join(); }
+  for (size_t j = 0; j < batch.size(); ++j, ++checked) {
+    if (checked >= serialHashes.size() || hashes[j] != serialHashes[checked]) {
+      context->Error() << "BRIG differs: " << batch[j].first << std::endl;
+      ++mismatches;
+    }
+  }
+  batch.clear();
+}
+
+bool EmissionCheck::Run(TestSet& tests)
+{
+  SerialEmitter serial(this);
+  tests.Iterate(serial);
+  ParallelEmitter parallel(this);
+  tests.Iterate(parallel);
+  EmitBatch();
+  if (checked != serialHashes.size()) {
+    context->Error() << "Number of tests differs: " << serialHashes.size() << " on one thread, " <<
+      checked << " on " << threads << " threads" << std::endl;
+    return false;
+  }
+  context->Info() << "Emitted " << checked << " tests on one and " << threads << " threads, " <<
+    mismatches << " differ" << std::endl;
+  return mismatches == 0;
+}
+
+void HCRunner::SetLogStreams(std::ostream* out)
+{
+  context->Put("hexl.log.stream.debug", out);
+  context->Put("hexl.log.stream.info", out);
+  context->Put("hexl.log.stream.error", out);
+}
+
+void HCRunner::StartLog()
+{
+  logWriter.reset(new AsyncLogWriter());
+  logStream.reset(new AsyncLogStream(logWriter.get(), &std::cout));
+  context->Put("hexl.log.writer", logWriter.get());
+  SetLogStreams(logStream.get());
+}
+
+void HCRunner::StopLog()
+{
+  if (!logWriter) { return; }
+  // Replacing the streams invalidates log streams cached by all contexts,
+  // so none of them refers to logStream once it is destroyed.
+  SetLogStreams(&std::cout);
+  context->Delete("hexl.log.writer");
+  logStream.reset();
+  logWriter.reset();
+}
+
 TestRunner* HCRunner::CreateTestRunner()
 {
   std::string runner = options.GetString("runner");
@@ -145,6 +332,7 @@ TestRunner* HCRunner::CreateTestRunner()
     }
     RemoteTestRunner* remoteTestRunner = new RemoteTestRunner(context, options.GetString("remote"));
     if (!remoteTestRunner->Connect()) {
+      StopLog();
       exit(19);
     }
     return remoteTestRunner;
@@ -171,19 +359,42 @@ TestSet* HCRunner::CreateTestSet()
     if (fts != ts) {
       ts->InitContext(context.get());
       ts = fts;
+      createdTests.push_back(std::unique_ptr<TestSet>(ts));
     }
   }
+  if (options.IsSet("coverage")) {
+    unsigned strength;
+    CoverageTestSet::ParseCoverage(options.GetString("coverage"), strength);
+    ts = new CoverageTestSet(ts, strength, context.get());
+    createdTests.push_back(std::unique_ptr<TestSet>(ts));
+  }
+  if (options.IsSet("sample")) {
+    unsigned count;
+    uint64_t seed;
+    SampleTestSet::ParseSample(options.GetString("sample"), count);
+    SampleTestSet::ParseSeed(options.GetString("seed"), seed);
+    ts = new SampleTestSet(ts, count, seed);
+    createdTests.push_back(std::unique_ptr<TestSet>(ts));
+  }
+  if (options.IsSet("shard")) {
+    unsigned index, count;
+    ShardTestSet::ParseShard(options.GetString("shard"), index, count);
+    ts = new ShardTestSet(ts, index, count);
+    createdTests.push_back(std::unique_ptr<TestSet>(ts));
+  }
+  // With test workers the runner selects tests within the budget once,
+  // in the parent.
+  if (options.IsSet("budget") && !UseWorkers()) {
+    uint64_t budget;
+    BudgetTestSet::ParseBudget(options.GetString("budget"), budget);
+    ts = new BudgetTestSet(ts, budget, options.GetString("history"));
+    createdTests.push_back(std::unique_ptr<TestSet>(ts));
+  }
   return ts;
 }
 
 void HCRunner::Run()
 {
-  std::cout <<
-    "HSA Conformance" <<
-    " (" <<
-    "HSAIL " << BRIG_VERSION_HSAIL_MAJOR << "." << BRIG_VERSION_HSAIL_MINOR <<
-    ", BRIG " << BRIG_VERSION_BRIG_MAJOR << "." << BRIG_VERSION_BRIG_MINOR <<
-    ")" << std::endl;
   OptionRegistry optReg;
   optReg.RegisterOption("rt");
   optReg.RegisterOption("runner");
@@ -207,8 +418,42 @@ void HCRunner::Run()
   optReg.RegisterOption("match");
   optReg.RegisterOption("timeout");
   optReg.RegisterOption("profile");
+  optReg.RegisterOption("lookahead");
+  optReg.RegisterOption("jobs");
+  optReg.RegisterBooleanOption("isolate");
+  optReg.RegisterOption("watchdog");
+  optReg.RegisterOption("journal");
+  optReg.RegisterOption("resume");
+  optReg.RegisterOption("history");
+  optReg.RegisterOption("timings");
+  optReg.RegisterOption("jsonresults");
+  optReg.RegisterOption("junit");
+  optReg.RegisterOption("repeat");
+  optReg.RegisterOption("shard");
+  optReg.RegisterOption("coverage");
+  optReg.RegisterOption("budget");
+  optReg.RegisterOption("sample");
+  optReg.RegisterOption("seed");
+  optReg.RegisterOption("codecache");
+  optReg.RegisterOption("emitcheck");
+  optReg.RegisterOption("wavesize");
+  optReg.RegisterBooleanOption("list");
+  optReg.RegisterBooleanOption("count");
+  optReg.RegisterOption("worker");
   {
     int n = hexl::ParseOptions(argc, argv, optReg, options);
+    bool listOnly = options.GetBoolean("list") || options.GetBoolean("count");
+    // Output of -list and -count is only names or number of tests,
+    // a test worker leaves the banner to the parent.
+    bool quiet = listOnly || options.IsSet("worker");
+    if (!quiet) {
+      std::cout <<
+        "HSA Conformance" <<
+        " (" <<
+        "HSAIL " << BRIG_VERSION_HSAIL_MAJOR << "." << BRIG_VERSION_HSAIL_MINOR <<
+        ", BRIG " << BRIG_VERSION_BRIG_MAJOR << "." << BRIG_VERSION_BRIG_MINOR <<
+        ")" << std::endl;
+    }
     if (n != 0) {
       std::cout << "Invalid option: " << argv[n] << std::endl;
       exit(4);
@@ -227,19 +472,135 @@ void HCRunner::Run()
       std::cout << "Invalid profile option: '" << profile << "'" << std::endl;
       exit(7);
     }
+    std::string tests = options.GetString("tests");
+    TestNamePattern testsPattern;
+    std::string error;
+    if (tests != "all" && !testsPattern.Compile(tests, error)) {
+      std::cout << error << std::endl;
+      exit(22);
+    }
+    unsigned shardIndex, shardCount;
+    if (options.IsSet("shard") && !ShardTestSet::ParseShard(options.GetString("shard"), shardIndex, shardCount)) {
+      std::cout << "Invalid shard option: '" << options.GetString("shard") << "'" << std::endl;
+      exit(21);
+    }
+    unsigned coverageStrength;
+    if (options.IsSet("coverage") && !CoverageTestSet::ParseCoverage(options.GetString("coverage"), coverageStrength)) {
+      std::cout << "Invalid coverage option: '" << options.GetString("coverage") << "'" << std::endl;
+      exit(23);
+    }
+    uint64_t budget;
+    if (options.IsSet("budget") && !BudgetTestSet::ParseBudget(options.GetString("budget"), budget)) {
+      std::cout << "Invalid budget option: '" << options.GetString("budget") << "'" << std::endl;
+      exit(24);
+    }
+    unsigned sampleCount;
+    if (options.IsSet("sample") && !SampleTestSet::ParseSample(options.GetString("sample"), sampleCount)) {
+      std::cout << "Invalid sample option: '" << options.GetString("sample") << "'" << std::endl;
+      exit(25);
+    }
+    uint64_t seed;
+    if (options.IsSet("seed") && !SampleTestSet::ParseSeed(options.GetString("seed"), seed)) {
+      std::cout << "Invalid seed option: '" << options.GetString("seed") << "'" << std::endl;
+      exit(26);
+    }
+    if (options.IsSet("emitcheck")) {
+      std::istringstream ss(options.GetString("emitcheck"));
+      unsigned threads = 0;
+      if (!(ss >> threads) || !ss.eof() || threads == 0) {
+        std::cout << "Invalid emitcheck option: '" << options.GetString("emitcheck") << "'" << std::endl;
+        exit(27);
+      }
+    }
+    if (options.IsSet("wavesize")) {
+      std::istringstream ss(options.GetString("wavesize"));
+      unsigned wavesize = 0;
+      // Wavesize is a power of 2 from 1 to 64.
+      if (!(ss >> wavesize) || !ss.eof() || wavesize == 0 || wavesize > 64 || (wavesize & (wavesize - 1)) != 0) {
+        std::cout << "Invalid wavesize option: '" << options.GetString("wavesize") << "'" << std::endl;
+        exit(29);
+      }
+    }
+    if (options.IsSet("sample")) {
+      if (!options.IsSet("seed")) {
+        // New sample every run. Workers are given this seed, they draw the same tests.
+        std::ostringstream ss;
+        ss << (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        options.SetString("seed", ss.str());
+      }
+      if (!quiet) {
+        std::cout << "Sample of " << options.GetString("sample") << " tests per parameter product, seed " << options.GetString("seed") << std::endl;
+      }
+    }
   }
   context->Move("hexl.stats", new AllStats());
   ResourceManager* rm = new DirectoryResourceManager(options.GetString("testbase", "."), options.GetString("results", "."));
   context->Put("hexl.rm", rm);
   context->Put("hexl.options", &options);
+  context->Put("hexl.testFactory", testFactory);
+  if (options.GetBoolean("list") || options.GetBoolean("count")) {
+    ListTests();
+    delete rm;
+    return;
+  }
+  if (options.IsSet("worker")) {
+    // Test worker started by the pool of the parent process.
+    HCTestPool pool(context.get(), 1, this);
+    if (!pool.Attach(options.GetString("worker"))) {
+      std::cout << "Invalid worker option: '" << options.GetString("worker") << "'" << std::endl;
+      exit(4);
+    }
+    int code = RunWorker(&pool);
+    delete rm;
+    exit(code);
+  }
+  StartLog();
+
+  if (options.IsSet("emitcheck")) {
+    bool ok = CheckEmission(options.GetUnsigned("emitcheck", 1));
+    StopLog();
+    delete rm;
+    if (!ok) { exit(28); }
+    return;
+  }
+
+  unsigned jobs = options.GetUnsigned("jobs", 1);
+  if (UseWorkers()) {
+    // Each worker creates its own runtime context.
+    HCTestPool pool(context.get(), jobs > 0 ? jobs : 1, this);
+    uint32_t wavesize, wavesPerGroup;
+    BrigProfile profile;
+    if (!pool.Start() || !pool.AgentConfig(wavesize, wavesPerGroup, profile)) {
+      StopLog();
+      std::cout << "Failed to start test workers" << std::endl;
+      exit(9);
+    }
+    context->Put(TEST_POOL_KEY, (TestProcessPool*) &pool);
+    // Tests are enumerated here with core configuration of the agent of workers.
+    runtime::RuntimeContext* runtime = CreateNoneRuntime(context.get(), wavesize, wavesPerGroup, profile);
+    context->Put("hexl.runtime", runtime);
+    coreConfig = CoreConfig::CreateAndInitialize(context.get());
+    context->Put(CoreConfig::CONTEXT_KEY, coreConfig);
+    runner = CreateTestRunner();
+    TestSet* tests = CreateTestSet();
+    assert(tests);
+    runner->RunTests(*tests);
+    delete runner; runner = 0;
+    context->Delete(TEST_POOL_KEY);
+    StopLog();
+    delete runtime;
+    delete rm;
+    return;
+  }
+
   runtime::RuntimeContext* runtime = 0;
   runtime = CreateRuntimeContext(context.get());
   if (!runtime) {
+    StopLog();
     std::cout << "Failed to create runtime" << std::endl;
     exit(8);
   }
   context->Put("hexl.runtime", runtime);
-  context->Put("hexl.testFactory", testFactory);
 
   coreConfig = CoreConfig::CreateAndInitialize(context.get());
   context->Put(CoreConfig::CONTEXT_KEY, coreConfig);
@@ -251,10 +612,104 @@ void HCRunner::Run()
 
   // cleanup in reverse order. new never fails.
   delete runner; runner = 0;
+  StopLog();
   if (runtime) { delete runtime; } 
   delete rm;
 }
 
+runtime::RuntimeContext* HCRunner::CreateConfigRuntime()
+{
+  // Core configuration depends on wavesize. With -wavesize or -rt none
+  // the none runtime provides it without initializing HSA, otherwise
+  // it is that of the agent.
+  runtime::RuntimeContext* runtime;
+  if (options.IsSet("wavesize") || options.GetString("rt", "hsa") == "none") {
+    runtime = CreateNoneRuntime(context.get());
+  } else {
+    runtime = CreateRuntimeContext(context.get());
+    if (!runtime) {
+      std::cout << "Failed to create runtime" << std::endl;
+      exit(8);
+    }
+  }
+  context->Put("hexl.runtime", runtime);
+  coreConfig = CoreConfig::CreateAndInitialize(context.get());
+  context->Put(CoreConfig::CONTEXT_KEY, coreConfig);
+  return runtime;
+}
+
+void HCRunner::ReleaseConfigRuntime(runtime::RuntimeContext* runtime)
+{
+  context->Delete(CoreConfig::CONTEXT_KEY);
+  delete coreConfig; coreConfig = 0;
+  context->Delete("hexl.runtime");
+  delete runtime;
+}
+
+void HCRunner::ListTests()
+{
+  // Tests are not created, so no BRIG is emitted.
+  runtime::RuntimeContext* runtime = CreateConfigRuntime();
+
+  TestSet* tests = CreateTestSet();
+  assert(tests);
+  TestNameList list(context.get(), options.GetBoolean("list") ? &std::cout : 0);
+  tests->Iterate(list);
+  if (options.GetBoolean("count")) { std::cout << list.Count() << "\n"; }
+  std::cout.flush();
+  if (options.GetBoolean("verbose")) {
+    std::cerr <<
+      "Test names: " << Test::NameLookups() << " lookups, " <<
+      Test::NameRenders() << " rendered" << std::endl;
+  }
+  createdTests.clear();
+  ReleaseConfigRuntime(runtime);
+}
+
+bool HCRunner::CheckEmission(unsigned threads)
+{
+  // Emission only depends on core configuration.
+  runtime::RuntimeContext* runtime = CreateConfigRuntime();
+
+  TestSet* tests = CreateTestSet();
+  assert(tests);
+  EmissionCheck check(context.get(), threads);
+  bool ok = check.Run(*tests);
+  createdTests.clear();
+  ReleaseConfigRuntime(runtime);
+  return ok;
+}
+
+void HCRunner::WorkerArgs(std::vector<std::string>& args)
+{
+  args.assign(argv, argv + argc);
+  // Seed drawn by the parent for -sample, last occurrence of an option wins.
+  if (options.IsSet("seed")) {
+    args.push_back("-seed");
+    args.push_back(options.GetString("seed"));
+  }
+}
+
+int HCRunner::RunWorker(TestProcessPool* pool)
+{
+  runtime::RuntimeContext* runtime = CreateRuntimeContext(context.get());
+  if (!runtime) {
+    std::cout << "Failed to create runtime" << std::endl;
+    return 8;
+  }
+  context->Put("hexl.runtime", runtime);
+
+  coreConfig = CoreConfig::CreateAndInitialize(context.get());
+  context->Put(CoreConfig::CONTEXT_KEY, coreConfig);
+
+  TestSet* tests = CreateTestSet();
+  assert(tests);
+  TestWorkerRunner worker(context.get(), pool);
+  worker.RunTests(*tests);
+  delete runtime;
+  return 0;
+}
+
 }
 
 int main(int argc, char **argv)